@@ -0,0 +1,160 @@
+#ifndef AUDIO_CACHE_HPP
+#define AUDIO_CACHE_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <filesystem>
+#include <system_error>
+
+#include "MappedFile.hpp"
+
+// On-disk cache of rendered audio, one file per request.
+// Entries only ever appear complete: they are written under a temporary name and renamed into place.
+class AudioCache {
+public:
+    explicit AudioCache(const std::string& directory) : directory_{ directory } {
+        std::filesystem::create_directories(directory_);
+    }
+
+    // Stable key for everything that determines the audio (request body, voice, format...)
+    static std::string makeKey(const std::string& request_description) {
+        uint64_t hash = 14695981039346656037ull; // FNV-1a
+        for (unsigned char c : request_description) {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        char key[17];
+        std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hash));
+        return key;
+    }
+
+    std::string path(const std::string& key) const { return (directory_ / (key + ".audio")).string(); }
+
+    bool contains(const std::string& key) const {
+        std::error_code ec;
+        return std::filesystem::file_size(path(key), ec) > 0 && !ec;
+    }
+
+    // Maps a committed entry for replay, or returns nullptr on a miss
+    std::unique_ptr<MappedFile> open(const std::string& key) const {
+        if (!contains(key)) {
+            return nullptr;
+        }
+        return std::make_unique<MappedFile>(path(key));
+    }
+
+private:
+    std::filesystem::path directory_;
+};
+
+// Write-through tee for one stream. write() is called on the curl thread and only appends to
+// an in-memory buffer; a background thread does the file I/O. commit() publishes the entry
+// atomically, anything else (abort(), destruction, write failure) leaves the cache untouched.
+class CacheTee {
+public:
+    CacheTee(const AudioCache& cache, const std::string& key)
+        : final_path_{ cache.path(key) }, temp_path_{ final_path_ + '.' + uniqueSuffix() + ".partial" },
+          file_{ temp_path_, std::ios::binary | std::ios::trunc }, writer_{ &CacheTee::run, this } {}
+
+    ~CacheTee() { abort(); }
+
+    CacheTee(const CacheTee&) = delete;
+    CacheTee& operator=(const CacheTee&) = delete;
+
+    void write(const void* data, size_t size) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            pending_.insert(pending_.end(), bytes, bytes + size);
+        }
+        cv_.notify_one();
+    }
+
+    // Waits for outstanding writes and moves the entry into place; returns false if nothing was cached
+    bool commit() {
+        if (!stop()) {
+            return false;
+        }
+        file_.close();
+        std::error_code ec;
+        if (file_.fail() || std::filesystem::file_size(temp_path_, ec) == 0 || ec) {
+            std::filesystem::remove(temp_path_, ec);
+            return false;
+        }
+        std::filesystem::rename(temp_path_, final_path_, ec);
+        if (ec) {
+            std::filesystem::remove(temp_path_, ec);
+            return false;
+        }
+        return true;
+    }
+
+    void abort() {
+        if (stop()) {
+            file_.close();
+            std::error_code ec;
+            std::filesystem::remove(temp_path_, ec);
+        }
+    }
+
+private:
+    std::string             final_path_;
+    std::string             temp_path_;
+    std::ofstream           file_;
+    std::vector<uint8_t>    pending_;
+    bool                    done_ = false;
+    std::mutex              mutex_;
+    std::condition_variable cv_;
+    std::thread             writer_;
+
+    // Each tee writes its own temp file, so streams of the same phrase running at once (other clients,
+    // other processes sharing the directory) never share an inode; whichever commits last wins.
+    static std::string uniqueSuffix() {
+        static const uint64_t process = (static_cast<uint64_t>(std::random_device{}()) << 32) ^ std::random_device{}();
+        static std::atomic<uint64_t> counter{ 0 };
+        char suffix[40];
+        std::snprintf(suffix, sizeof(suffix), "%016llx-%llu", static_cast<unsigned long long>(process),
+            static_cast<unsigned long long>(counter.fetch_add(1, std::memory_order_relaxed)));
+        return suffix;
+    }
+
+    // Returns true the first time, once the writer has drained everything
+    bool stop() {
+        if (!writer_.joinable()) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+        }
+        cv_.notify_one();
+        writer_.join();
+        return true;
+    }
+
+    void run() {
+        std::vector<uint8_t> batch;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this]() { return done_ || !pending_.empty(); });
+            if (pending_.empty() && done_) {
+                return;
+            }
+            batch.swap(pending_); // hand back an empty (already allocated) buffer to the curl thread
+            lock.unlock();
+            file_.write(reinterpret_cast<const char*>(batch.data()), static_cast<std::streamsize>(batch.size()));
+            batch.clear();
+            lock.lock();
+        }
+    }
+};
+
+#endif // !AUDIO_CACHE_HPP
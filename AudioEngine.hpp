@@ -0,0 +1,413 @@
+#ifndef AUDIO_ENGINE_HPP
+#define AUDIO_ENGINE_HPP
+
+#include <iostream>
+#include <array>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <portaudio.h>
+#include "TraceRecorder.hpp"
+
+// Single-producer / single-consumer ring buffer (curl thread -> audio callback)
+template <typename T, size_t Capacity = 128>
+class LockFreeQueue {
+public:
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    LockFreeQueue() {}
+
+    // Pushes all items or none of them
+    bool tryPush(const T* items, size_t count) {
+        auto head = m_head.load(std::memory_order_relaxed);
+        auto tail = m_tail.load(std::memory_order_acquire);
+        if (Capacity - (head - tail) < count) {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            m_data[(head + i) & (Capacity - 1)] = items[i];
+        }
+        m_head.store(head + count, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T* item) {
+        return pop(item, 1) == 1;
+    }
+
+    // Pops up to count items, returns how many were popped
+    size_t pop(T* items, size_t count) {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        auto head = m_head.load(std::memory_order_acquire);
+        size_t available = (std::min)(count, static_cast<size_t>(head - tail));
+        for (size_t i = 0; i < available; i++) {
+            items[i] = m_data[(tail + i) & (Capacity - 1)];
+        }
+        m_tail.store(tail + available, std::memory_order_release);
+        return available;
+    }
+
+    size_t size() const {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+    size_t pushed() const { return m_head.load(std::memory_order_acquire); }
+    size_t popped() const { return m_tail.load(std::memory_order_acquire); }
+
+private:
+    std::array<T, Capacity> m_data;
+    std::atomic<size_t> m_head{ 0 }; // total items pushed
+    std::atomic<size_t> m_tail{ 0 }; // total items popped
+};
+
+// Playback buffer with flow control. The writer pauses the transfer once the buffer passes
+// the high watermark; the transfer is resumed after the audio callback drains it below the
+// low watermark, so memory per stream stays bounded however long the utterance is.
+class PlaybackBuffer {
+public:
+    // A curl write callback delivers at most CURL_MAX_WRITE_SIZE bytes, which must fit under the high watermark
+    static constexpr size_t kCapacity = 32768;                 // ~1.4 s of 24 kHz mono
+    static constexpr size_t kHighWatermark = kCapacity * 3 / 4;
+    static constexpr size_t kLowWatermark = kCapacity / 4;
+    // Largest single write: a full CURL_MAX_WRITE_SIZE (16 KiB) chunk of pcm_16000 resampled to 24 kHz
+    static constexpr size_t kMaxWriteSamples = 16384 / sizeof(int16_t) * 3 / 2 + 1;
+
+    // All or nothing: returns false (and marks the buffer paused) if the samples would pass the high watermark
+    bool write(const int16_t* samples, size_t count) {
+        if (queue_.size() + count > kHighWatermark || !queue_.tryPush(samples, count)) {
+            paused_.store(true, std::memory_order_release);
+            return false;
+        }
+        return true;
+    }
+
+    size_t read(int16_t* samples, size_t count) { return queue_.pop(samples, count); }
+
+    size_t size() const { return queue_.size(); }
+
+    // Running totals of samples written and read, so one utterance's samples can be told from the last one's
+    size_t written() const { return queue_.pushed(); }
+    size_t consumed() const { return queue_.popped(); }
+
+    bool paused() const { return paused_.load(std::memory_order_acquire); }
+
+    // True once a paused writer can continue; clears the paused state
+    bool takeResume() {
+        if (paused() && queue_.size() <= kLowWatermark) {
+            paused_.store(false, std::memory_order_release);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    LockFreeQueue<int16_t, kCapacity> queue_;
+    std::atomic<bool> paused_{ false };
+};
+
+inline PlaybackBuffer audioBuffer;
+
+// #define   paPrimeOutputBuffersUsingStreamCallback ((PaStreamFlags) 0x00000008)
+#define paPrimingOutput    ((PaStreamCallbackFlags) 0x00000010)
+#define paOutputUnderflow ((PaStreamCallbackFlags)0x04)
+#define paOutputOverflow ((PaStreamCallbackFlags)0x08)
+
+// Long-lived output device. PortAudio is initialised and the stream opened once; the callback
+// plays silence while idle, so a new utterance only has to put samples in audioBuffer.
+class AudioEngine {
+public:
+    static const int kSampleRate = 24000;
+    static const unsigned long kFramesPerBuffer = 2048;
+    // Longest prebuffer that always fills: any more and the writer could pause on the high watermark
+    // before enough is queued, with playback still waiting for it (~511 ms)
+    static constexpr size_t kMaxPrebufferSamples = PlaybackBuffer::kHighWatermark - PlaybackBuffer::kMaxWriteSamples;
+
+    static AudioEngine& instance() {
+        static AudioEngine engine;
+        return engine;
+    }
+
+    ~AudioEngine() { stop(); }
+
+    AudioEngine(const AudioEngine&) = delete;
+    AudioEngine& operator=(const AudioEngine&) = delete;
+
+    // Opens and starts the device if it is not running yet; cheap when it already is
+    bool start() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stream_ != nullptr || driven_) {
+            return true;
+        }
+        // the callback must not lock or allocate, so its trace buffer is made here
+        ELEVENLABS_TRACE_PREALLOCATE_THREAD(trace_buffer_, "audio callback");
+
+        // Initialize PortAudio
+        PaError err = Pa_Initialize();
+        if (err != paNoError) {
+            std::cerr << "PortAudio error: " << Pa_GetErrorText(err) << std::endl;
+            return false;
+        }
+
+        // Open an audio I/O stream
+        err = Pa_OpenDefaultStream(&stream_,
+            0,                  // No input channels
+            1,                  // Mono output
+            paInt16,            // 16-bit PCM
+            kSampleRate,        // Sample rate
+            kFramesPerBuffer,   // Frames per buffer
+            AudioCallback,      // Callback function
+            this);              // Callback data
+        if (err == paNoError) {
+            err = Pa_StartStream(stream_);
+        }
+        if (err != paNoError) {
+            std::cerr << "PortAudio error: " << Pa_GetErrorText(err) << std::endl;
+            if (stream_ != nullptr) {
+                Pa_CloseStream(stream_);
+                stream_ = nullptr;
+            }
+            Pa_Terminate();
+            return false;
+        }
+        return true;
+    }
+
+    // Closes the device and terminates PortAudio
+    void stop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stream_ == nullptr) {
+            return;
+        }
+        Pa_StopStream(stream_);
+        Pa_CloseStream(stream_);
+        Pa_Terminate();
+        stream_ = nullptr;
+    }
+
+    bool running() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stream_ != nullptr || driven_;
+    }
+
+    // Waits until everything queued so far has been handed to the device
+    void drain() {
+        while (running() && audioBuffer.size() > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    // Marks the start of an utterance; call it before start() so device startup is counted. Playback
+    // of it is held back until prebuffer_samples are queued (at most kMaxPrebufferSamples), the
+    // writer pauses or the utterance ends, while whatever is left of the previous one keeps playing.
+    // The time until its first sample reaches the device callback is then available from lastStartLatencyMs().
+    void beginUtterance(size_t prebuffer_samples = 0) {
+        prebuffer_samples_.store((std::min)(prebuffer_samples, kMaxPrebufferSamples), std::memory_order_relaxed);
+        utterance_start_ns_.store(now(), std::memory_order_relaxed);
+        first_sample_.store(audioBuffer.written(), std::memory_order_relaxed);
+        awaiting_first_sample_.store(true, std::memory_order_release);
+        producing_.store(true, std::memory_order_release);
+    }
+
+    // Marks that no more audio is coming for the current utterance; silence after this is idle, not an underrun
+    void endUtterance() { producing_.store(false, std::memory_order_release); }
+
+    double lastStartLatencyMs() const { return start_latency_ns_.load(std::memory_order_acquire) / 1e6; }
+
+    // Number of callbacks so far that ran short while an utterance was still producing audio
+    size_t underruns() const { return underruns_.load(std::memory_order_relaxed); }
+
+    // Fills one device buffer from audioBuffer. Called from the PortAudio callback, or from a
+    // RenderDriver's thread when there is no device.
+    void render(int16_t* out, unsigned long framesPerBuffer) {
+        ELEVENLABS_TRACE_SCOPE("audio callback");
+        // samples before first_sample are the previous utterance's tail and always play; a paused
+        // writer cannot add any more, so waiting for the rest of the prebuffer would never end
+        const bool awaiting = awaiting_first_sample_.load(std::memory_order_acquire);
+        const size_t first_sample = first_sample_.load(std::memory_order_relaxed);
+        size_t limit = framesPerBuffer;
+        if (awaiting && producing_.load(std::memory_order_acquire) && !audioBuffer.paused()
+            && audioBuffer.written() - first_sample < prebuffer_samples_.load(std::memory_order_relaxed)) {
+            const size_t consumed = audioBuffer.consumed();
+            limit = std::min<size_t>(limit, first_sample > consumed ? first_sample - consumed : 0);
+        }
+        size_t read = audioBuffer.read(out, limit);
+        std::fill(out + read, out + framesPerBuffer, int16_t{ 0 }); // silence while idle or on underrun
+        ELEVENLABS_TRACE_COUNTER("playback buffer", audioBuffer.size());
+        if (awaiting && audioBuffer.consumed() > first_sample && awaiting_first_sample_.exchange(false, std::memory_order_acq_rel)) {
+            int64_t latency = now() - utterance_start_ns_.load(std::memory_order_relaxed);
+            start_latency_ns_.store(latency, std::memory_order_release);
+            ELEVENLABS_TRACE_INSTANT_ARG("utterance start", "latency us", latency / 1000);
+        }
+        else if (read < framesPerBuffer && producing_.load(std::memory_order_acquire)
+            && !awaiting_first_sample_.load(std::memory_order_relaxed)) {
+            underruns_.fetch_add(1, std::memory_order_relaxed);
+            ELEVENLABS_TRACE_INSTANT_ARG("underrun", "missing samples", framesPerBuffer - read);
+        }
+    }
+
+private:
+    friend class RenderDriver;
+
+    AudioEngine() {}
+
+    void setDriven(bool driven) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (driven && stream_ != nullptr) {
+            throw std::runtime_error("the audio device is already running");
+        }
+        driven_ = driven;
+    }
+
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static int AudioCallback(const void* inputBuffer, void* outputBuffer,
+        unsigned long framesPerBuffer,
+        const PaStreamCallbackTimeInfo* timeInfo,
+        PaStreamCallbackFlags statusFlags,
+        void* userData) {
+        AudioEngine* engine = static_cast<AudioEngine*>(userData);
+        (void)inputBuffer; // Prevent unused variable warning
+        (void)timeInfo;
+        ELEVENLABS_TRACE_ATTACH_THREAD(engine->trace_buffer_);
+        engine->render(static_cast<int16_t*>(outputBuffer), framesPerBuffer);
+        if (statusFlags & paOutputUnderflow) {
+            ELEVENLABS_TRACE_INSTANT("output underflow");
+        }
+        return paContinue;
+    }
+
+    mutable std::mutex   mutex_;
+    PaStream*            stream_ = nullptr;
+    bool                 driven_ = false;           // a RenderDriver stands in for the device
+    std::atomic<bool>    awaiting_first_sample_{ false };
+    std::atomic<bool>    producing_{ false };
+    std::atomic<size_t>  prebuffer_samples_{ 0 };
+    std::atomic<size_t>  first_sample_{ 0 };       // audioBuffer.written() when the utterance began
+    std::atomic<size_t>  underruns_{ 0 };
+    std::atomic<int64_t> utterance_start_ns_{ 0 };
+    std::atomic<int64_t> start_latency_ns_{ 0 };
+    ELEVENLABS_TRACE_THREAD_BUFFER(trace_buffer_);
+};
+
+// Brackets one utterance on the shared engine
+class UtteranceScope {
+public:
+    explicit UtteranceScope(size_t prebuffer_samples = 0) { AudioEngine::instance().beginUtterance(prebuffer_samples); }
+    ~UtteranceScope() { AudioEngine::instance().endUtterance(); }
+};
+
+// Stands in for the output device: calls AudioEngine::render() from its own thread, one buffer per
+// period, so streams run end to end without a sound card (LatencyBench). While one exists, start()
+// leaves PortAudio alone.
+class RenderDriver {
+public:
+    RenderDriver() {
+        AudioEngine::instance().setDriven(true);
+        thread_ = std::thread([this]() {
+            std::vector<int16_t> out(AudioEngine::kFramesPerBuffer);
+            const auto period = std::chrono::microseconds(1000000 * AudioEngine::kFramesPerBuffer / AudioEngine::kSampleRate);
+            for (auto next = std::chrono::steady_clock::now(); running_.load(std::memory_order_acquire); next += period) {
+                std::this_thread::sleep_until(next);
+                AudioEngine::instance().render(out.data(), AudioEngine::kFramesPerBuffer);
+            }
+        });
+    }
+
+    ~RenderDriver() {
+        running_.store(false, std::memory_order_release);
+        thread_.join();
+        AudioEngine::instance().setDriven(false);
+    }
+
+    RenderDriver(const RenderDriver&) = delete;
+    RenderDriver& operator=(const RenderDriver&) = delete;
+
+private:
+    std::atomic<bool> running_{ true };
+    std::thread       thread_;
+};
+
+// Linear-interpolation converter from a stream's PCM rate to the device rate. State carries
+// over between chunks; it is a small value type, so a caller can try a chunk on a copy.
+class Resampler {
+public:
+    explicit Resampler(int input_rate = AudioEngine::kSampleRate)
+        : step_{ static_cast<double>(input_rate) / AudioEngine::kSampleRate } {}
+
+    bool passthrough() const { return step_ == 1.0; }
+
+    // Appends the converted samples to out
+    void process(const int16_t* in, size_t count, std::vector<int16_t>& out) {
+        if (count == 0) {
+            return;
+        }
+        // positions are in input samples; 0 is last_, i is in[i - 1]
+        double pos = pos_;
+        while (pos < static_cast<double>(count)) {
+            size_t i = static_cast<size_t>(pos);
+            double frac = pos - static_cast<double>(i);
+            double a = i == 0 ? last_ : in[i - 1];
+            double b = in[i];
+            out.push_back(static_cast<int16_t>(a + (b - a) * frac));
+            pos += step_;
+        }
+        pos_ = pos - static_cast<double>(count);
+        last_ = in[count - 1];
+    }
+
+private:
+    double  step_;
+    double  pos_ = 0.0;
+    int16_t last_ = 0;
+};
+
+// Queue raw 16-bit PCM for playback (audio views from a PromptBundle, etc.), waiting while the buffer is full
+inline void enqueueAudio(const uint8_t* data, size_t size, int sample_rate = AudioEngine::kSampleRate) {
+    const int16_t* audioData = reinterpret_cast<const int16_t*>(data);
+    size_t remaining = size / sizeof(int16_t);
+    Resampler resampler(sample_rate);
+    std::vector<int16_t> converted;
+    while (remaining > 0) {
+        size_t count = (std::min)(remaining, PlaybackBuffer::kLowWatermark / 2);
+        const int16_t* samples = audioData;
+        size_t samples_count = count;
+        Resampler next = resampler;
+        if (!resampler.passthrough()) {
+            converted.clear();
+            next.process(audioData, count, converted);
+            samples = converted.data();
+            samples_count = converted.size();
+        }
+        if (!audioBuffer.write(samples, samples_count)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+        resampler = next;
+        audioData += count;
+        remaining -= count;
+    }
+}
+
+// Starts the shared output device if needed
+inline void startStream() {
+    AudioEngine::instance().start();
+}
+
+// Lets queued audio finish, then closes the device and terminates PortAudio
+inline void closeStream() {
+    std::cout << "Closing stream...\n";
+    AudioEngine::instance().drain();
+    AudioEngine::instance().stop();
+}
+
+#endif // !AUDIO_ENGINE_HPP
@@ -0,0 +1,178 @@
+﻿/*****************************************************************//**
+ * \file   CaptureReplay.cpp
+ * \brief  Local HTTP server that plays back a capture made with ELEVENLABS_CAPTURE
+ *
+ * Usage: CaptureReplay <capture.bin> [port] [speed]
+ *
+ * Point a client at it with ELEVENLABS_API_BASE=http://127.0.0.1:<port>/v1
+ * (the path must match the one that was captured). Each request is answered
+ * with a recorded response for the same method and path, preferring the same
+ * query string and body; repeated requests cycle through the recordings. Chunks are
+ * sent with their recorded boundaries at their recorded offsets from the
+ * request, divided by speed (2 = twice as fast, 0 = as fast as possible).
+ * A transfer that failed during capture is cut off after its last chunk.
+ *********************************************************************/
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "HttpCapture.hpp"
+#include "LoopbackHttp.hpp"
+
+// "https://api.elevenlabs.io/v1/voices?x=1" -> "/v1/voices?x=1"
+static std::string requestTarget(const std::string& url) {
+	size_t scheme = url.find("://");
+	size_t path = url.find('/', scheme == std::string::npos ? 0 : scheme + 3);
+	return path == std::string::npos ? "/" : url.substr(path);
+}
+
+// "/v1/voices?x=1" -> "/v1/voices"
+static std::string withoutQuery(const std::string& target) { return target.substr(0, target.find('?')); }
+
+class Recordings {
+public:
+	explicit Recordings(std::vector<CapturedExchange> exchanges) : exchanges_{ std::move(exchanges) } {
+		for (size_t i = 0; i < exchanges_.size(); i++) {
+			const std::string target = requestTarget(exchanges_[i].url);
+			by_target_[exchanges_[i].method + " " + target].indices.push_back(i);
+			by_path_[exchanges_[i].method + " " + withoutQuery(target)].indices.push_back(i);
+		}
+	}
+
+	size_t size() const { return exchanges_.size(); }
+
+	// Exact method and target first, then the same path with different query parameters (a new build may
+	// pick other streaming parameters than the captured one). Returns nullptr if nothing was recorded.
+	const CapturedExchange* match(const std::string& method, const std::string& target, const std::string& body) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = by_target_.find(method + " " + target);
+		if (it == by_target_.end()) {
+			it = by_path_.find(method + " " + withoutQuery(target));
+			if (it == by_path_.end()) {
+				return nullptr;
+			}
+		}
+		return &exchanges_[pick(it->second, body)];
+	}
+
+private:
+	struct Candidates {
+		std::vector<size_t> indices;
+		size_t              next = 0;
+	};
+
+	std::vector<CapturedExchange>     exchanges_;
+	std::map<std::string, Candidates> by_target_;
+	std::map<std::string, Candidates> by_path_;
+	std::mutex                        mutex_;
+
+	// Next recording with the same body, else simply the next one
+	size_t pick(Candidates& candidates, const std::string& body) {
+		const size_t count = candidates.indices.size();
+		for (size_t step = 0; step < count; step++) {
+			size_t slot = (candidates.next + step) % count;
+			if (exchanges_[candidates.indices[slot]].body == body) {
+				candidates.next = slot + 1;
+				return candidates.indices[slot];
+			}
+		}
+		return candidates.indices[candidates.next++ % count];
+	}
+};
+
+static const char* reason(uint32_t status) {
+	switch (status) {
+	case 200: return "OK";
+	case 400: return "Bad Request";
+	case 401: return "Unauthorized";
+	case 404: return "Not Found";
+	case 422: return "Unprocessable Entity";
+	case 429: return "Too Many Requests";
+	default:  return status < 400 ? "OK" : "Error";
+	}
+}
+
+// Returns false once the connection should be closed
+static bool replay(socket_t s, const CapturedExchange& exchange, double speed, std::chrono::steady_clock::time_point received) {
+	std::ostringstream head;
+	head << "HTTP/1.1 " << exchange.status << ' ' << reason(exchange.status) << "\r\n";
+	if (!exchange.content_type.empty()) {
+		head << "Content-Type: " << exchange.content_type << "\r\n";
+	}
+	head << "Transfer-Encoding: chunked\r\n\r\n";
+
+	// headers go out with the first chunk so time to first byte is the recorded one
+	std::string pending = head.str();
+	for (const auto& chunk : exchange.chunks) {
+		if (speed > 0.0) {
+			std::this_thread::sleep_until(received + std::chrono::microseconds(static_cast<int64_t>(chunk.at_us / speed)));
+		}
+		appendChunk(pending, chunk.data.data(), chunk.data.size());
+		if (!sendAll(s, pending)) return false;
+		pending.clear();
+	}
+	if (exchange.curl_code != 0) {
+		return false; // the captured transfer failed part way; end it the same way
+	}
+	pending += "0\r\n\r\n";
+	return sendAll(s, pending);
+}
+
+static void serve(socket_t s, Recordings& recordings, double speed) {
+	setNoDelay(s);
+	Connection connection(s);
+	HttpRequest request;
+	while (readRequest(connection, request)) {
+		auto received = std::chrono::steady_clock::now();
+		const CapturedExchange* exchange = recordings.match(request.method, request.target, request.body);
+		if (exchange == nullptr) {
+			std::cerr << request.method << ' ' << request.target << " -> no recording" << std::endl;
+			std::string body = "{\"detail\": \"no recording for " + request.method + " " + request.target + "\"}";
+			std::ostringstream response;
+			response << "HTTP/1.1 404 Not Found\r\nContent-Type: application/json\r\nContent-Length: " << body.size() << "\r\n\r\n" << body;
+			if (!sendAll(s, response.str())) break;
+			continue;
+		}
+		std::cout << request.method << ' ' << request.target << " -> " << exchange->status << ", "
+			<< exchange->chunks.size() << " chunks" << std::endl;
+		if (!replay(s, *exchange, speed, received) || !request.keep_alive) break;
+	}
+	closeSocket(s);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " <capture.bin> [port] [speed]\n";
+		return 1;
+	}
+	const int port = argc > 2 ? std::atoi(argv[2]) : 8080;
+	const double speed = argc > 3 ? std::atof(argv[3]) : 1.0;
+
+	try {
+		Recordings recordings(readCapture(argv[1]));
+		std::cout << "Loaded " << recordings.size() << " recorded requests\n";
+
+		startSockets();
+		int bound_port = port;
+		socket_t listener = listenLoopback(port, bound_port);
+		if (listener == INVALID_SOCKET) {
+			std::cerr << "cannot listen on port " << port << '\n';
+			return 1;
+		}
+		std::cout << "Replaying on http://127.0.0.1:" << bound_port << " at speed " << speed << '\n';
+
+		while (true) {
+			socket_t client = accept(listener, nullptr, nullptr);
+			if (client == INVALID_SOCKET) continue;
+			std::thread(serve, client, std::ref(recordings), speed).detach();
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+}
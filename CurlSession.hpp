@@ -14,6 +14,14 @@
 #include <atomic>
 #include <condition_variable>
 #include <fstream>
+#include <array>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <utility>
+#include <functional>
+#include <memory>
+#include <cmath>
 
 #ifndef CURL_STATICLIB
 #include <curl/curl.h>
@@ -22,116 +30,13 @@
 #endif
 
 #include <nlohmann/json.hpp>  // nlohmann/json
-#include <portaudio.h>
-
-template <typename T>
-class LockFreeQueue {
-public:
-    LockFreeQueue() {}
-
-    void push(const T& item) {
-        while (true) {
-            auto head = m_head.load(std::memory_order_acquire);
-            auto tail = m_tail.load(std::memory_order_relaxed);
-            auto next = head + 1;
-            if (next == m_capacity) {
-                next = 0;
-            }
-            if (next != tail) {
-                if (m_head.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed)) {
-                    m_data[head] = item;
-                    return;
-                }
-            }
-        }
-    }
-
-    bool pop(T* item) {
-        while (true) {
-            auto tail = m_tail.load(std::memory_order_acquire);
-            auto head = m_head.load(std::memory_order_relaxed);
-            if (head == tail) {
-                return false; // Queue is empty
-            }
-            *item = m_data[tail];
-            auto next = tail + 1;
-            if (next == m_capacity) {
-                next = 0;
-            }
-            if (m_tail.compare_exchange_weak(tail, next, std::memory_order_release, std::memory_order_relaxed)) {
-                return true;
-            }
-        }
-    }
-
-private:
-    static const size_t m_capacity = 100; // Adjust the capacity as per your requirement
-    std::array<T, m_capacity> m_data;
-    std::atomic<size_t> m_head = 0;
-    std::atomic<size_t> m_tail = 0;
-};
-
-PaStream* stream;
-LockFreeQueue<int16_t> audioQueue;
-
-// #define   paPrimeOutputBuffersUsingStreamCallback ((PaStreamFlags) 0x00000008)
-#define paPrimingOutput    ((PaStreamCallbackFlags) 0x00000010)
-#define paOutputUnderflow ((PaStreamCallbackFlags)0x04)
-#define paOutputOverflow ((PaStreamCallbackFlags)0x08)
-static int AudioCallback(const void* inputBuffer, void* outputBuffer,
-    unsigned long framesPerBuffer,
-    const PaStreamCallbackTimeInfo* timeInfo,
-    PaStreamCallbackFlags statusFlags,
-    void* userData) {
-    int16_t* out = static_cast<int16_t*>(outputBuffer);
-    (void)inputBuffer; // Prevent unused variable warning
-    int16_t sample;
-    for (unsigned long i = 0; i < framesPerBuffer; i++) {
-        if (audioQueue.pop(&sample)) {
-            *out++ = sample;
-        }
-    }
-    return paContinue;
-}
-
-
-void startStream() {
-    // Initialize PortAudio
-    PaError err = Pa_Initialize();
-    if (err != paNoError) {
-        std::cerr << "PortAudio error: " << Pa_GetErrorText(err) << std::endl;
-        return;
-    }
-
-    // Open an audio I/O stream
-    err = Pa_OpenDefaultStream(&stream,
-        0,          // No input channels
-        1,          // Mono output
-        paInt16,    // 16-bit PCM
-        24000,      // Sample rate
-        2048,        // Frames per buffer
-        AudioCallback,      // Callback function
-        nullptr);           // No callback data
-    if (err != paNoError) {
-        std::cerr << "PortAudio error: " << Pa_GetErrorText(err) << std::endl;
-        return;
-    }
-
-    err = Pa_StartStream(stream);
-    if (err != paNoError) {
-        std::cerr << "PortAudio error: " << Pa_GetErrorText(err) << std::endl;
-        return;
-    }
-}
-
-// Remember to close the stream and terminate PortAudio when done
-void closeStream() {
-    std::cout << "Closing stream...\n";
-    Pa_StopStream(stream);
-    Pa_CloseStream(stream);
-    Pa_Terminate();
-}
-
+#include "TraceRecorder.hpp"
+#include "AudioEngine.hpp"
+#include "TelephonySink.hpp"
+#include "MappedFile.hpp"
+#include "AudioCache.hpp"
+#include "LatencyController.hpp"
+#include "HttpCapture.hpp"
 
 // Json alias
 using Json = nlohmann::json;
@@ -150,6 +55,8 @@ public:
         std::queue<std::vector<uint8_t>> empty;
         std::swap(chunks_, empty);
         is_end_ = false;
+        is_error_ = false;
+        cancelled_ = false;
     }
 
     void set(const std::vector<uint8_t>& data) {
@@ -172,9 +79,162 @@ public:
         return is_end_;
     }
 
+    // Called when a request starts; takeFirstChunk() is then true exactly once, for the first chunk received
+    void beginTransfer() {
+        awaiting_first_chunk_ = true;
+        redelivery_ = false;
+        carry_.clear();
+        timing_ = Timing{};
+        timing_.begin = Clock::now();
+    }
+    bool takeFirstChunk() { return std::exchange(awaiting_first_chunk_, false); }
+
+    // PCM rate of the incoming stream; chunks are converted to the device rate before playback
+    void setSampleRate(int sample_rate) {
+        sample_rate_ = sample_rate;
+        resampler_ = Resampler(sample_rate);
+    }
+
+    // Queues a chunk for playback, all or nothing. Returns false if playback is too far behind,
+    // in which case curl will deliver the same chunk again once the transfer is resumed.
+    bool play(const char* data, size_t size) {
+        const auto now = Clock::now();
+        if (redelivery_) {
+            redelivery_ = false; // the chunk we paused on, not a new arrival
+        }
+        else if (!timing_.throttled) {
+            // once paused, data queued up in the meantime arrives in a burst and says nothing about the network
+            recordArrival(now, size);
+        }
+
+        if (call_ != nullptr) {
+            if (call_->write(data, size)) {
+                return true;
+            }
+            redelivery_ = true;
+            timing_.throttled = true;
+            return false;
+        }
+
+        // a chunk can end half way through a sample; that byte is kept for the next one
+        const char* bytes = data;
+        size_t length = size;
+        if (!carry_.empty()) {
+            joined_.assign(carry_).append(data, size);
+            bytes = joined_.data();
+            length = joined_.size();
+        }
+        pcm_.resize(length / sizeof(int16_t));
+        if (!pcm_.empty()) {
+            std::memcpy(pcm_.data(), bytes, pcm_.size() * sizeof(int16_t));
+        }
+        bool written;
+        Resampler next = resampler_;
+        if (resampler_.passthrough()) {
+            written = audioBuffer.write(pcm_.data(), pcm_.size());
+        }
+        else {
+            converted_.clear();
+            next.process(pcm_.data(), pcm_.size(), converted_);
+            written = audioBuffer.write(converted_.data(), converted_.size());
+        }
+        if (written) {
+            resampler_ = next;
+            carry_.assign(bytes + pcm_.size() * sizeof(int16_t), length % sizeof(int16_t));
+            return true;
+        }
+        redelivery_ = true;
+        timing_.throttled = true;
+        return false;
+    }
+
+    // Timing of the last transfer; underruns are filled in by the caller, who owns the device
+    StreamStats stats() const {
+        StreamStats stats;
+        stats.chunks = timing_.chunks;
+        if (timing_.chunks == 0) {
+            return stats;
+        }
+        stats.ttfb_ms = std::chrono::duration<double, std::milli>(timing_.first - timing_.begin).count();
+        if (timing_.chunks > 1) {
+            double n = static_cast<double>(timing_.chunks - 1);
+            double mean = timing_.gap_sum_ms / n;
+            stats.jitter_ms = std::sqrt((std::max)(0.0, timing_.gap_sq_sum_ms / n - mean * mean));
+        }
+        stats.max_gap_ms = timing_.max_gap_ms;
+        stats.throttled = timing_.throttled;
+        double active_s = timing_.gap_sum_ms / 1000.0;
+        double audio_s = static_cast<double>(timing_.bytes - timing_.first_bytes) / sizeof(int16_t) / sample_rate_;
+        stats.realtime_factor = active_s > 0.0 ? audio_s / active_s : 0.0;
+        return stats;
+    }
+
+    // Called when the request finishes, with whether it failed (curl error or HTTP error status)
+    void endTransfer(bool is_error) {
+        is_error_ = is_error;
+        is_end_ = true;
+    }
+    bool is_error() const { return is_error_; }
+
+    // Aborts the transfer; safe to call from any thread
+    void cancel() { cancelled_ = true; }
+    bool cancelled() const { return cancelled_; }
+
+    // Optional write-through cache entry that receives every chunk played (not owned)
+    void setTee(CacheTee* tee) { tee_ = tee; }
+    CacheTee* tee() const { return tee_; }
+
+    // Sends the stream to a phone call instead of the local speaker when set (not owned)
+    void setCall(TelephonyCall* call) { call_ = call; }
+    TelephonyCall* call() const { return call_; }
+
+    // Where play() queues audio; the transfer is paused and resumed on this buffer's watermarks
+    PlaybackBuffer& output() { return call_ != nullptr ? call_->buffer() : audioBuffer; }
+
 private:
     std::queue<std::vector<uint8_t>> chunks_;
     bool is_end_;
+    bool awaiting_first_chunk_ = false;
+
+    using Clock = std::chrono::steady_clock;
+    struct Timing {
+        Clock::time_point begin, first, last;
+        size_t            chunks = 0;
+        size_t            first_bytes = 0;
+        bool              throttled = false;  // paused at least once; later arrivals are not sampled
+        size_t            bytes = 0;
+        double            gap_sum_ms = 0.0;
+        double            gap_sq_sum_ms = 0.0;
+        double            max_gap_ms = 0.0;
+    };
+    Timing timing_;
+    bool redelivery_ = false;
+    int sample_rate_ = AudioEngine::kSampleRate;
+    Resampler resampler_;
+    std::string carry_;
+    std::string joined_;
+    std::vector<int16_t> pcm_;
+    std::vector<int16_t> converted_;
+
+    void recordArrival(Clock::time_point now, size_t size) {
+        if (timing_.chunks == 0) {
+            timing_.first = now;
+            timing_.first_bytes = size;
+        }
+        else {
+            double gap = std::chrono::duration<double, std::milli>(now - timing_.last).count();
+            timing_.gap_sum_ms += gap;
+            timing_.gap_sq_sum_ms += gap * gap;
+            timing_.max_gap_ms = (std::max)(timing_.max_gap_ms, gap);
+        }
+        timing_.last = now;
+        timing_.chunks++;
+        timing_.bytes += size;
+    }
+    bool is_error_ = false;
+    std::atomic<bool> cancelled_{ false };
+    CacheTee* tee_ = nullptr;
+    TelephonyCall* call_ = nullptr;
     mutable std::mutex mutex_;
     std::condition_variable cv_;
 
@@ -183,6 +243,202 @@ private:
     }
 };
 
+// One file part of a multipart upload, streamed to curl instead of being copied into the form.
+// Memory buffers and callbacks must stay valid until the request has completed.
+struct MultipartFile {
+    using ReadCallback = std::function<size_t(char* buffer, size_t size)>; // return 0 at end of data
+
+    std::string  name = "files"; // form field; "files" is what the voice endpoints expect
+    std::string  filename;
+    std::string  content_type;   // e.g. "audio/mpeg"
+
+    const void*  data = nullptr;  // memory buffer (not copied)
+    size_t       size = 0;
+    std::string  path;            // file on disk, memory-mapped
+    ReadCallback read;            // caller-provided reader
+    curl_off_t   read_size = -1;  // total bytes produced by read, -1 if unknown
+
+    static MultipartFile fromMemory(const std::string& filename, const std::string& content_type, const void* data, size_t size) {
+        MultipartFile file;
+        file.filename = filename;
+        file.content_type = content_type;
+        file.data = data;
+        file.size = size;
+        return file;
+    }
+
+    static MultipartFile fromFile(const std::string& path, const std::string& content_type) {
+        MultipartFile file;
+        file.filename = path.substr(path.find_last_of("/\\") + 1);
+        file.content_type = content_type;
+        file.path = path;
+        return file;
+    }
+
+    static MultipartFile fromCallback(const std::string& filename, const std::string& content_type, ReadCallback read, curl_off_t read_size = -1) {
+        MultipartFile file;
+        file.filename = filename;
+        file.content_type = content_type;
+        file.read = std::move(read);
+        file.read_size = read_size;
+        return file;
+    }
+};
+
+// Upload progress: bytes sent so far and total bytes to send (0 if not known yet)
+using UploadProgress = std::function<void(curl_off_t uploaded, curl_off_t total)>;
+
+// libcurl is initialised once per process, not once per Session
+inline void curlGlobalInit() {
+    static struct CurlGlobal {
+        CurlGlobal() { curl_global_init(CURL_GLOBAL_ALL); }
+        ~CurlGlobal() { curl_global_cleanup(); }
+    } curl_global;
+}
+
+// One multi handle and thread that drive the streamed transfers of every Session. A transfer that
+// writeStreamFunction paused on a full playback buffer only holds up its own handle; the loop resumes
+// it once the buffer drains and keeps the other sessions' transfers moving in the meantime.
+class CurlEventLoop {
+public:
+    static CurlEventLoop& shared() {
+        static CurlEventLoop loop;
+        return loop;
+    }
+
+    ~CurlEventLoop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        curl_multi_wakeup(multi_);
+        thread_.join();
+        curl_multi_cleanup(multi_);
+    }
+
+    CurlEventLoop(const CurlEventLoop&) = delete;
+    CurlEventLoop& operator=(const CurlEventLoop&) = delete;
+
+    // Runs the transfer on the loop thread, which also calls its callbacks, and waits for it to finish
+    CURLcode perform(CURL* easy, PlaybackBuffer* output) {
+        Transfer transfer{ easy, output };
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                return CURLE_FAILED_INIT;
+            }
+            incoming_.push_back(&transfer);
+        }
+        curl_multi_wakeup(multi_);
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [&transfer]() { return transfer.done; });
+        return transfer.result;
+    }
+
+private:
+    struct Transfer {
+        CURL*           easy;
+        PlaybackBuffer* output;
+        CURLcode        result = CURLE_OK;
+        bool            done = false;
+    };
+
+    CurlEventLoop() {
+        curlGlobalInit(); // constructed first, so curl is cleaned up after the loop has stopped
+        multi_ = curl_multi_init();
+        if (multi_ == nullptr) {
+            throw std::runtime_error("curl cannot initialize");
+        }
+        thread_ = std::thread(&CurlEventLoop::run, this);
+    }
+
+    void finish(Transfer* transfer, CURLcode result) {
+        curl_multi_remove_handle(multi_, transfer->easy);
+        active_.erase(std::find(active_.begin(), active_.end(), transfer));
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            transfer->result = result;
+            transfer->done = true;
+        }
+        done_.notify_all();
+    }
+
+    void run() {
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stopping_) {
+                    break;
+                }
+                added_.swap(incoming_);
+            }
+            for (Transfer* transfer : added_) {
+                active_.push_back(transfer);
+                if (curl_multi_add_handle(multi_, transfer->easy) != CURLM_OK) {
+                    finish(transfer, CURLE_FAILED_INIT);
+                }
+            }
+            added_.clear();
+
+            int running = 0;
+            CURLMcode mc = curl_multi_perform(multi_, &running);
+            int queued = 0;
+            while (CURLMsg* msg = curl_multi_info_read(multi_, &queued)) {
+                if (msg->msg != CURLMSG_DONE) {
+                    continue;
+                }
+                for (Transfer* transfer : active_) {
+                    if (transfer->easy == msg->easy_handle) {
+                        finish(transfer, msg->data.result);
+                        break;
+                    }
+                }
+            }
+
+            bool paused = false;
+            for (Transfer* transfer : active_) {
+                if (transfer->output->takeResume()) {
+                    ELEVENLABS_TRACE_INSTANT("resume");
+                    curl_easy_pause(transfer->easy, CURLPAUSE_CONT);
+                }
+                paused |= transfer->output->paused();
+            }
+            if (mc == CURLM_OK) {
+                // poll often while paused so the resume lands well before the low watermark runs dry
+                mc = curl_multi_poll(multi_, nullptr, 0, paused ? 5 : 100, nullptr);
+            }
+            if (mc != CURLM_OK) {
+                while (!active_.empty()) {
+                    finish(active_.back(), CURLE_FAILED_INIT);
+                }
+            }
+        }
+
+        // shutting down: release anyone still waiting
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (Transfer* transfer : incoming_) {
+            active_.push_back(transfer);
+        }
+        incoming_.clear();
+        for (Transfer* transfer : active_) {
+            curl_multi_remove_handle(multi_, transfer->easy);
+            transfer->result = CURLE_FAILED_INIT;
+            transfer->done = true;
+        }
+        active_.clear();
+        done_.notify_all();
+    }
+
+    CURLM*                  multi_ = nullptr;
+    std::mutex              mutex_;
+    std::condition_variable done_;
+    std::vector<Transfer*>  incoming_; // submitted, not yet added to multi_
+    std::vector<Transfer*>  added_;    // loop thread only
+    std::vector<Transfer*>  active_;   // loop thread only
+    bool                    stopping_ = false;
+    std::thread             thread_;
+};
+
 // Simple curl Session inspired by CPR
 class Session {
 public:
@@ -199,14 +455,13 @@ public:
 
     ~Session() {
         curl_easy_cleanup(curl_);
-        curl_global_cleanup();
         if (mime_form_ != nullptr) {
             curl_mime_free(mime_form_);
         }
     }
 
     void initCurl() {
-        curl_global_init(CURL_GLOBAL_ALL);
+        curlGlobalInit();
         curl_ = curl_easy_init();
         if (curl_ == nullptr) {
             throw std::runtime_error("curl cannot initialize"); // here we throw it shouldn't happen
@@ -231,6 +486,7 @@ public:
 
     void setBody(const std::string& data);
     void setMultiformPart(const std::pair<std::string, std::string>& filefield_and_filepath, const std::map<std::string, std::string>& fields);
+    void setMultipart(const std::vector<MultipartFile>& files, const std::map<std::string, std::string>& fields, UploadProgress progress = nullptr);
 
     Response getPrepare(const std::string& authorizationHeader = "", const std::string& accept = "");
     Response postPrepare(
@@ -248,7 +504,57 @@ public:
    );
     std::string easyEscape(const std::string& text);
 
+    // HTTP status of the last response, 0 if none was received
+    long responseCode() const {
+        long status = 0;
+        curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &status);
+        return status;
+    }
+
+    // Records every following request and its response, chunk by chunk, to a capture file (see HttpCapture.hpp)
+    void startCapture(const std::string& path) { capture_ = CaptureWriter::shared(path); }
+    void stopCapture() { capture_.reset(); }
+    bool capturing() const { return capture_ != nullptr; }
+
 private:
+    CURLcode perform(PlaybackBuffer* output);
+
+    // Read position within one streamed multipart file
+    struct MimeSource {
+        const char*                 data = nullptr;
+        size_t                      size = 0;
+        size_t                      offset = 0;
+        std::unique_ptr<MappedFile> mapping;
+        MultipartFile::ReadCallback read;
+    };
+
+    static size_t mimeRead(char* buffer, size_t size, size_t nitems, void* arg) {
+        MimeSource* source = static_cast<MimeSource*>(arg);
+        size_t wanted = size * nitems;
+        if (source->read) {
+            return source->read(buffer, wanted);
+        }
+        size_t count = (std::min)(wanted, source->size - source->offset);
+        std::memcpy(buffer, source->data + source->offset, count);
+        source->offset += count;
+        return count;
+    }
+
+    // Lets curl rewind a part, e.g. when a request is retried after a redirect
+    static int mimeSeek(void* arg, curl_off_t offset, int origin) {
+        MimeSource* source = static_cast<MimeSource*>(arg);
+        if (source->read || origin != SEEK_SET || offset < 0 || static_cast<size_t>(offset) > source->size) {
+            return CURL_SEEKFUNC_CANTSEEK;
+        }
+        source->offset = static_cast<size_t>(offset);
+        return CURL_SEEKFUNC_OK;
+    }
+
+    static int uploadProgressFunction(void* clientp, curl_off_t, curl_off_t, curl_off_t ultotal, curl_off_t ulnow) {
+        (*static_cast<UploadProgress*>(clientp))(ulnow, ultotal);
+        return 0;
+    }
+
     static size_t writeFunction(void* ptr, size_t size, size_t nmemb, std::string* data) {
         data->append((char*)ptr, size * nmemb);
         return size * nmemb;
@@ -256,26 +562,73 @@ private:
 
     static size_t writeStreamFunction(char* ptr, size_t size, size_t nmemb, void* userdata) {
         size_t real_size = size * nmemb;
-        if (real_size > 200) {
-            std::cout << "Received audio chunk...\n";
-            // Assuming incoming audio data is in the form of int16_t samples
-            int16_t* audioData = reinterpret_cast<int16_t*>(ptr);
-            for (size_t i = 0; i < real_size / sizeof(int16_t); i++) { 
-                audioQueue.push(audioData[i]);
-            }
+        StreamResponse* response = static_cast<StreamResponse*>(userdata);
+        if (response->cancelled()) {
+            return 0; // makes curl abort the transfer
+        }
+        if (response->takeFirstChunk()) {
+            ELEVENLABS_TRACE_INSTANT("first byte");
+        }
+        ELEVENLABS_TRACE_INSTANT_ARG("chunk", "bytes", real_size);
+        // If playback is too far behind, leave the data with curl and pause until it drains.
+        if (!response->play(ptr, real_size)) {
+            ELEVENLABS_TRACE_INSTANT("pause");
+            return CURL_WRITEFUNC_PAUSE;
+        }
+        ELEVENLABS_TRACE_COUNTER("playback buffer", response->output().size());
+        if (response->tee() != nullptr) {
+            response->tee()->write(ptr, real_size);
         }
 
         return real_size;
     }
 
+    // Sits in front of the real write callback while capturing. A chunk is recorded once the
+    // callback has taken it, timestamped when curl first offered it so pauses do not shift it.
+    static size_t captureWriteFunction(char* ptr, size_t size, size_t nmemb, void* userdata) {
+        size_t real_size = size * nmemb;
+        Session* session = static_cast<Session*>(userdata);
+        uint64_t offered_us = session->capture_offered_us_ >= 0
+            ? static_cast<uint64_t>(session->capture_offered_us_) : session->captureElapsedUs();
+        size_t taken = session->capture_stream_ != nullptr
+            ? writeStreamFunction(ptr, size, nmemb, session->capture_stream_)
+            : writeFunction(ptr, size, nmemb, session->capture_text_);
+        if (taken == CURL_WRITEFUNC_PAUSE) {
+            session->capture_offered_us_ = static_cast<int64_t>(offered_us);
+            return taken;
+        }
+        session->capture_offered_us_ = -1;
+        if (taken == real_size) {
+            session->capture_->chunk(session->capture_id_, offered_us, ptr, real_size);
+        }
+        return taken;
+    }
+
+    uint64_t captureElapsedUs() const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - capture_started_).count());
+    }
+
 private:
     CURL* curl_;
     CURLcode    res_;
     curl_mime* mime_form_ = nullptr;
+    std::vector<std::unique_ptr<MimeSource>> mime_sources_;
+    UploadProgress upload_progress_;
     std::string url_;
     std::string proxy_url_;
     std::string token_;
     std::string organization_;
+    std::string method_ = "POST";
+
+    // capture state, only used while capture_ is set
+    std::shared_ptr<CaptureWriter> capture_;
+    std::chrono::steady_clock::time_point capture_started_;
+    std::string     capture_body_;
+    uint32_t        capture_id_ = 0;
+    int64_t         capture_offered_us_ = -1;
+    StreamResponse* capture_stream_ = nullptr;
+    std::string*    capture_text_ = nullptr;
 
     bool        throw_exception_;
     std::mutex  mutex_request_;
@@ -286,6 +639,9 @@ inline void Session::setBody(const std::string& data) {
         curl_easy_setopt(curl_, CURLOPT_POSTFIELDSIZE, data.length());
         curl_easy_setopt(curl_, CURLOPT_POSTFIELDS, data.data());
     }
+    if (capture_) {
+        capture_body_ = data;
+    }
 }
 
 inline void Session::setMultiformPart(const std::pair<std::string, std::string>& fieldfield_and_filepath, const std::map<std::string, std::string>& fields) {
@@ -298,6 +654,7 @@ inline void Session::setMultiformPart(const std::pair<std::string, std::string>&
         curl_mimepart* field = nullptr;
 
         mime_form_ = curl_mime_init(curl_);
+        capture_body_.clear(); // multipart bodies are not captured
 
         field = curl_mime_addpart(mime_form_);
         curl_mime_name(field, fieldfield_and_filepath.first.c_str());
@@ -313,16 +670,70 @@ inline void Session::setMultiformPart(const std::pair<std::string, std::string>&
     }
 }
 
+inline void Session::setMultipart(const std::vector<MultipartFile>& files, const std::map<std::string, std::string>& fields, UploadProgress progress) {
+    // https://curl.se/libcurl/c/curl_mime_data_cb.html
+    if (curl_) {
+        if (mime_form_ != nullptr) {
+            curl_mime_free(mime_form_);
+            mime_form_ = nullptr;
+        }
+        mime_sources_.clear();
+
+        mime_form_ = curl_mime_init(curl_);
+        capture_body_.clear(); // multipart bodies are not captured
+
+        for (const auto& file : files) {
+            auto source = std::make_unique<MimeSource>();
+            curl_off_t size = -1;
+            if (file.read) {
+                source->read = file.read;
+                size = file.read_size;
+            }
+            else if (!file.path.empty()) {
+                source->mapping = std::make_unique<MappedFile>(file.path);
+                source->data = reinterpret_cast<const char*>(source->mapping->data());
+                source->size = source->mapping->size();
+                size = static_cast<curl_off_t>(source->size);
+            }
+            else {
+                source->data = static_cast<const char*>(file.data);
+                source->size = file.size;
+                size = static_cast<curl_off_t>(source->size);
+            }
+
+            curl_mimepart* field = curl_mime_addpart(mime_form_);
+            curl_mime_name(field, file.name.c_str());
+            curl_mime_filename(field, file.filename.c_str());
+            if (!file.content_type.empty()) {
+                curl_mime_type(field, file.content_type.c_str());
+            }
+            curl_mime_data_cb(field, size, mimeRead, mimeSeek, nullptr, source.get());
+            mime_sources_.emplace_back(std::move(source));
+        }
+
+        for (const auto& field_pair : fields) {
+            curl_mimepart* field = curl_mime_addpart(mime_form_);
+            curl_mime_name(field, field_pair.first.c_str());
+            curl_mime_data(field, field_pair.second.c_str(), CURL_ZERO_TERMINATED);
+        }
+
+        curl_easy_setopt(curl_, CURLOPT_MIMEPOST, mime_form_);
+        upload_progress_ = std::move(progress);
+    }
+}
+
 inline Response Session::getPrepare(const std::string& authorizationHeader, const std::string& accept) {
     if (curl_) {
         curl_easy_setopt(curl_, CURLOPT_HTTPGET, 1L);
         curl_easy_setopt(curl_, CURLOPT_POST, 0L);
         curl_easy_setopt(curl_, CURLOPT_NOBODY, 0L);
     }
+    method_ = "GET";
     return makeRequest("", authorizationHeader, accept);
 }
 
 inline Response Session::postPrepare(const std::string& contentType, const std::string& authorizationHeader, const std::string& accept, StreamResponse* response) {
+    method_ = "POST";
     return makeRequest(contentType, authorizationHeader, accept, response);
 }
 
@@ -332,11 +743,13 @@ inline Response Session::deletePrepare() {
         curl_easy_setopt(curl_, CURLOPT_NOBODY, 0L);
         curl_easy_setopt(curl_, CURLOPT_CUSTOMREQUEST, "DELETE");
     }
+    method_ = "DELETE";
     return makeRequest();
 }
 
 inline Response Session::makeRequest(const std::string& contentType, const std::string& authorizationHeader, const std::string& accept, StreamResponse* response) {
     std::lock_guard<std::mutex> lock(mutex_request_);
+    ELEVENLABS_TRACE_SCOPE("request");
 
     struct curl_slist* headers = NULL;
     if (!contentType.empty()) {
@@ -361,20 +774,61 @@ inline Response Session::makeRequest(const std::string& contentType, const std::
     if (response != nullptr) {
         curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, writeStreamFunction);
         curl_easy_setopt(curl_, CURLOPT_WRITEDATA, (void*) response);
+        response->beginTransfer();
     }
     else {
         curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, writeFunction);
         curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &response_string);
     }
+    // without an explicit header function curl hands headers to the write callback
+    curl_easy_setopt(curl_, CURLOPT_HEADERFUNCTION, writeFunction);
     curl_easy_setopt(curl_, CURLOPT_HEADERDATA, &header_string);
 
-    res_ = curl_easy_perform(curl_);
+    if (capture_) {
+        capture_stream_ = response;
+        capture_text_ = &response_string;
+        capture_offered_us_ = -1;
+        capture_id_ = capture_->beginRequest(method_, url_, capture_body_);
+        capture_started_ = std::chrono::steady_clock::now();
+        curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, captureWriteFunction);
+        curl_easy_setopt(curl_, CURLOPT_WRITEDATA, (void*) this);
+    }
+
+    if (upload_progress_) {
+        curl_easy_setopt(curl_, CURLOPT_XFERINFOFUNCTION, uploadProgressFunction);
+        curl_easy_setopt(curl_, CURLOPT_XFERINFODATA, &upload_progress_);
+        curl_easy_setopt(curl_, CURLOPT_NOPROGRESS, 0L);
+    }
+
+    res_ = perform(response != nullptr ? &response->output() : nullptr);
+
+    if (upload_progress_) {
+        curl_easy_setopt(curl_, CURLOPT_NOPROGRESS, 1L);
+        upload_progress_ = nullptr;
+    }
+
+    if (capture_) {
+        long status = 0;
+        char* content_type = nullptr;
+        curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &status);
+        curl_easy_getinfo(curl_, CURLINFO_CONTENT_TYPE, &content_type);
+        capture_->endRequest(capture_id_, captureElapsedUs(), static_cast<uint32_t>(status), content_type != nullptr ? content_type : "", static_cast<uint32_t>(res_));
+    }
+
+    if (response != nullptr) {
+        long status = 0;
+        curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &status);
+        response->endTransfer(res_ != CURLE_OK || status >= 400);
+        if (response->cancelled()) {
+            return { "", false, "" }; // cancelled on purpose, not an error
+        }
+    }
 
     bool is_error = false;
     std::string error_msg{};
     if (res_ != CURLE_OK) {
         is_error = true;
-        error_msg = "ElevenLabs curl_easy_perform() failed: " + std::string{ curl_easy_strerror(res_) };
+        error_msg = "ElevenLabs curl request failed: " + std::string{ curl_easy_strerror(res_) };
         if (throw_exception_) {
             throw std::runtime_error(error_msg);
         }
@@ -390,6 +844,16 @@ inline Response Session::makeRequest(const std::string& contentType, const std::
 	}
 }
 
+// Streams go through the shared event loop rather than curl_easy_perform so that a transfer
+// paused by writeStreamFunction can be resumed once playback has drained the output buffer,
+// without holding up the streams of other sessions.
+inline CURLcode Session::perform(PlaybackBuffer* output) {
+    if (output == nullptr) {
+        return curl_easy_perform(curl_);
+    }
+    return CurlEventLoop::shared().perform(curl_, output);
+}
+
 inline std::string Session::easyEscape(const std::string& text) {
     char* encoded_output = curl_easy_escape(curl_, text.c_str(), static_cast<int>(text.length()));
     const auto str = std::string{ encoded_output };
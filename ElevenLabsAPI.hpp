@@ -3,6 +3,7 @@
 
 #include <string>
 #include "CurlSession.hpp"
+#include "RequestBody.hpp"
 
 #define ELEVENLABS_VERBOSE_OUTPUT 1
 
@@ -15,6 +16,8 @@ namespace elevenlabs {
     struct TextToSpeech {
         Json create(const std::string& text, const std::string& voice_id, const std::string& model_id);
         void stream(const std::string& text, const std::string& voice_id, const std::string& model_id, StreamResponse* stream_response);
+        void streamToCall(const std::string& text, const std::string& voice_id, const std::string& model_id, TelephonyCall& call, StreamResponse* stream_response);
+        std::string convert(const std::string& text, const std::string& voice_id, const std::string& model_id, const Json& voice_settings = Json{}, const std::string& output_format = "pcm_24000");
 
         TextToSpeech(ElevenLabs& elevenlabs) : elevenlabs_{ elevenlabs } {}
     private:
@@ -40,6 +43,8 @@ namespace elevenlabs {
         Json voiceSettings(const std::string& voice_id);
         Json editVoiceSettings(const std::string& voice_id, const Json& json);
         Json getVoice(const std::string& voice_id, bool include_settings = false);
+        Json addVoice(const std::string& name, const std::vector<MultipartFile>& samples, const std::string& description = "", const Json& labels = Json{}, UploadProgress progress = nullptr);
+        Json editVoice(const std::string& voice_id, const std::string& name, const std::vector<MultipartFile>& samples = {}, const std::string& description = "", const Json& labels = Json{}, UploadProgress progress = nullptr);
 
 		Voices(ElevenLabs& elevenlabs) : elevenlabs_{ elevenlabs } {}
     private:
@@ -70,6 +75,9 @@ namespace elevenlabs {
             }
             session_.setUrl(base_url);
             session_.setToken(token_, organization_);
+            if (const char* env_p = std::getenv("ELEVENLABS_CAPTURE")) {
+                session_.startCapture(env_p);
+            }
         }
 
         ElevenLabs(const ElevenLabs&) = delete;
@@ -79,10 +87,15 @@ namespace elevenlabs {
 
         void setProxy(const std::string& url) { session_.setProxyUrl(url); }
 
+        // Records all traffic to a capture file that CaptureReplay can serve back
+        void startCapture(const std::string& path) { session_.startCapture(path); }
+        void stopCapture() { session_.stopCapture(); }
+
         // void change_token(const std::string& token) { token_ = token; };
         void setThrowException(bool throw_exception) { throw_exception_ = throw_exception; }
 
         void setMultiformPart(const std::pair<std::string, std::string>& filefield_and_filepath, const std::map<std::string, std::string>& fields) { session_.setMultiformPart(filefield_and_filepath, fields); }
+        void setMultipart(const std::vector<MultipartFile>& files, const std::map<std::string, std::string>& fields, UploadProgress progress = nullptr) { session_.setMultipart(files, fields, std::move(progress)); }
 
         Json post(const std::string& suffix, const std::string& data, const std::string& contentType, const std::string& accept, StreamResponse* stream_response = nullptr) {
             setParameters(suffix, data, contentType);
@@ -107,6 +120,30 @@ namespace elevenlabs {
             return json;
         }
 
+        // Same as post() but returns the raw response body (audio bytes) instead of parsing it as JSON
+        std::string postBinary(const std::string& suffix, const std::string& data, const std::string& contentType, const std::string& accept) {
+            setParameters(suffix, data, contentType);
+            std::string authorizationHeader = "xi-api-key: ";
+            auto response = session_.postPrepare(contentType, authorizationHeader, accept);
+            if (response.is_error) {
+                trigger_error(response.error_message);
+                return {};
+            }
+
+            // audio is never valid JSON, so a JSON body here is an API error (e.g. {"detail": ...})
+            if (isJson(response.text)) {
+                trigger_error(response.text);
+                return {};
+            }
+            // nor is an error page from a proxy or gateway in front of the API
+            const long status = session_.responseCode();
+            if (status >= 400) {
+                trigger_error("HTTP " + std::to_string(status) + ": " + response.text.substr(0, 200));
+                return {};
+            }
+            return response.text;
+        }
+
         Json get(const std::string& suffix, const std::string& data = "") {
             setParameters(suffix, data);
             std::string authorizationHeader = "xi-api-key: ";
@@ -163,6 +200,14 @@ namespace elevenlabs {
             return base_url;
         }
 
+        // Streams are replayed from, and written through to, this cache when set (not owned)
+        void setAudioCache(AudioCache* cache) { audio_cache_ = cache; }
+        AudioCache* audioCache() const { return audio_cache_; }
+
+        // Streams take their latency level, output format and prebuffer from this controller when set (not owned)
+        void setLatencyController(LatencyController* controller) { latency_controller_ = controller; }
+        LatencyController* latencyController() const { return latency_controller_; }
+
     private:
         std::string base_url;
 
@@ -221,6 +266,8 @@ namespace elevenlabs {
         std::string             token_;
         std::string             organization_;
         bool                    throw_exception_;
+        AudioCache*             audio_cache_ = nullptr;
+        LatencyController*      latency_controller_ = nullptr;
     };
 
 
@@ -265,14 +312,12 @@ namespace elevenlabs {
     // POST 'https://api.elevenlabs.io/v1/text-to-speech/<voice-id>'
     // Creates a new text-to-speech request
     inline Json TextToSpeech::create(const std::string& text, const std::string& voice_id, const std::string& model_id) {
-		Json json;
-        json["text"] = text;
-		json["model_id"] = model_id;
-		return elevenlabs_.post("text-to-speech/" + voice_id, json, "application/json", "audio/mpeg");
+        const std::string& body = SynthesisRequestWriter::forThread().write(text, model_id);
+		return elevenlabs_.post("text-to-speech/" + voice_id, body, "application/json", "audio/mpeg");
 	}
 
     // Function to add query parameters to the URL
-    std::string buildUrlWithParams(const std::string& baseUrl, const std::map<std::string, std::string>& params) {
+    inline std::string buildUrlWithParams(const std::string& baseUrl, const std::map<std::string, std::string>& params) {
         std::string url = baseUrl;
         if (!params.empty()) {
             url += "?";
@@ -286,27 +331,98 @@ namespace elevenlabs {
 
     // POST 'https://api.elevenlabs.io/v1/text-to-speech/<voice-id>/stream'
     inline void TextToSpeech::stream(const std::string& text, const std::string& voice_id, const std::string& model_id, StreamResponse* stream_response) {
-		Json json;
-		json["text"] = text;
-		json["model_id"] = model_id;
-        Json voice_settings;
-        voice_settings["similarity_boost"] = 0.75;
-        voice_settings["stability"] = 0.5;
-        voice_settings["style"] = 0.0;
-        voice_settings["use_speaker_boost"] = true;
-        json["voice_settings"] = voice_settings;
-
-        // Add query parameters
+        const std::string& body = SynthesisRequestWriter::forThread().write(text, model_id, kDefaultStreamVoiceSettings);
+
+        // Add query parameters, tuned by the latency controller when there is one
+        LatencyController* controller = elevenlabs_.latencyController();
+        StreamParams params = controller != nullptr ? controller->params() : StreamParams{};
         std::map<std::string, std::string> queryParams;
-        queryParams["optimize_streaming_latency"] = "3";
-        queryParams["output_format"] = "pcm_24000"; // Set the desired output format
+        queryParams["optimize_streaming_latency"] = std::to_string(params.optimize_streaming_latency);
+        queryParams["output_format"] = params.output_format; // Set the desired output format
 
         // Build the URL with query parameters
         std::string urlWithParams = buildUrlWithParams("text-to-speech/" + voice_id + "/stream", queryParams);
 
 
+        // the clock starts before the device does, so first-use startup counts towards start latency
+        static_assert(LatencyController::kMaxPrebufferMs * AudioEngine::kSampleRate / 1000 <= AudioEngine::kMaxPrebufferSamples,
+            "the controller must not ask for a prebuffer the playback buffer cannot fill");
+        UtteranceScope utterance(static_cast<size_t>(params.prebuffer_ms) * AudioEngine::kSampleRate / 1000);
 		startStream();
-        elevenlabs_.post(urlWithParams, json, "application/json", "audio/mpeg", stream_response);
+        stream_response->setSampleRate(params.sampleRate());
+        const size_t underruns_before = AudioEngine::instance().underruns();
+
+        AudioCache* cache = elevenlabs_.audioCache();
+        std::unique_ptr<CacheTee> tee;
+        if (cache != nullptr) {
+            std::string key = AudioCache::makeKey(voice_id + '\n' + urlWithParams + '\n' + body);
+            if (auto cached = cache->open(key)) {
+                // replay locally, no network round trip
+                enqueueAudio(cached->data(), cached->size(), params.sampleRate());
+                return;
+            }
+            // tee the stream into the cache while it plays; only a clean, complete stream is committed
+            tee = std::make_unique<CacheTee>(*cache, key);
+            stream_response->setTee(tee.get());
+        }
+
+        try {
+            elevenlabs_.post(urlWithParams, body, "application/json", "audio/mpeg", stream_response);
+        }
+        catch (...) {
+            stream_response->setTee(nullptr);
+            throw; // tee destructor discards the partial entry
+        }
+        stream_response->setTee(nullptr);
+
+        bool completed = stream_response->is_end() && !stream_response->is_error() && !stream_response->cancelled();
+        if (tee != nullptr && completed) {
+            tee->commit();
+        }
+        if (controller != nullptr && completed) {
+            StreamStats stats = stream_response->stats();
+            stats.underruns = AudioEngine::instance().underruns() - underruns_before;
+            controller->record(stats);
+        }
+    }
+
+    // POST 'https://api.elevenlabs.io/v1/text-to-speech/<voice-id>/stream'
+    // Same request as stream(), but the audio goes to a phone call (see TelephonySink.hpp) in the call's input format
+    inline void TextToSpeech::streamToCall(const std::string& text, const std::string& voice_id, const std::string& model_id, TelephonyCall& call, StreamResponse* stream_response) {
+        const std::string& body = SynthesisRequestWriter::forThread().write(text, model_id, kDefaultStreamVoiceSettings);
+
+        LatencyController* controller = elevenlabs_.latencyController();
+        std::map<std::string, std::string> queryParams;
+        queryParams["optimize_streaming_latency"] = std::to_string(controller != nullptr ? controller->params().optimize_streaming_latency : 3);
+        queryParams["output_format"] = call.inputFormat();
+        std::string urlWithParams = buildUrlWithParams("text-to-speech/" + voice_id + "/stream", queryParams);
+
+        call.beginUtterance();
+        stream_response->setCall(&call);
+        try {
+            elevenlabs_.post(urlWithParams, body, "application/json", "audio/mpeg", stream_response);
+        }
+        catch (...) {
+            stream_response->setCall(nullptr);
+            call.endUtterance();
+            throw;
+        }
+        stream_response->setCall(nullptr);
+        call.endUtterance();
+    }
+
+    // POST 'https://api.elevenlabs.io/v1/text-to-speech/<voice-id>?output_format=<format>'
+    // Renders the whole utterance and returns the encoded audio bytes
+    inline std::string TextToSpeech::convert(const std::string& text, const std::string& voice_id, const std::string& model_id, const Json& voice_settings, const std::string& output_format) {
+        // only the caller's voice settings, if any, still go through the DOM
+        const std::string settings = voice_settings.is_null() ? std::string{} : voice_settings.dump();
+        const std::string& body = SynthesisRequestWriter::forThread().write(text, model_id, settings);
+
+        std::map<std::string, std::string> queryParams;
+        queryParams["output_format"] = output_format;
+        std::string urlWithParams = buildUrlWithParams("text-to-speech/" + voice_id, queryParams);
+
+        return elevenlabs_.postBinary(urlWithParams, body, "application/json", "audio/mpeg");
     }
 
     // GET 'https://api.elevenlabs.io/v1/models'
@@ -346,6 +462,32 @@ namespace elevenlabs {
         return elevenlabs_.get("voices/" + voice_id + "?with_settings=" + with_settings);
     }
 
+    inline std::map<std::string, std::string> voiceFields(const std::string& name, const std::string& description, const Json& labels) {
+        std::map<std::string, std::string> fields;
+        fields["name"] = name;
+        if (!description.empty()) {
+            fields["description"] = description;
+        }
+        if (!labels.is_null()) {
+            fields["labels"] = labels.dump();
+        }
+        return fields;
+    }
+
+    // POST 'https://api.elevenlabs.io/v1/voices/add'
+    // Clones a voice from audio samples; each sample is streamed from memory, a mapped file or a callback
+    inline Json Voices::addVoice(const std::string& name, const std::vector<MultipartFile>& samples, const std::string& description, const Json& labels, UploadProgress progress) {
+        elevenlabs_.setMultipart(samples, voiceFields(name, description, labels), std::move(progress));
+        return elevenlabs_.post("voices/add", std::string{}, "multipart/form-data", "application/json");
+    }
+
+    // POST 'https://api.elevenlabs.io/v1/voices/{voice_id}/edit'
+    // Renames a voice, updates its description/labels and optionally adds more samples
+    inline Json Voices::editVoice(const std::string& voice_id, const std::string& name, const std::vector<MultipartFile>& samples, const std::string& description, const Json& labels, UploadProgress progress) {
+        elevenlabs_.setMultipart(samples, voiceFields(name, description, labels), std::move(progress));
+        return elevenlabs_.post("voices/" + voice_id + "/edit", std::string{}, "multipart/form-data", "application/json");
+    }
+
     // 
 } // namespace elevenlabs
 #endif // !ELEVENLABS_API_HPP
@@ -71,13 +71,16 @@ int main()
 {
 	auto& ElevenLabs = elevenlabs::start("your_api_key_here");
 
+	ELEVENLABS_TRACE_THREAD_NAME("main");
 	std::cout << "Starting...\n";
 
 	StreamResponse* response = new StreamResponse();
 
 	std::string long_text = "Why is there still static I defined all the flags now";
 	elevenlabs::text_to_speech().stream(long_text, "your_voice_id_here", "eleven_turbo_v2", response);
+	std::cout << "Utterance start latency: " << AudioEngine::instance().lastStartLatencyMs() << " ms\n";
 	closeStream();
+	ELEVENLABS_TRACE_WRITE("elevenlabs_trace.json");
 	std::cout << "Press Enter to close stream...";
 	std::cin.get();
 
@@ -0,0 +1,186 @@
+#ifndef HTTP_CAPTURE_HPP
+#define HTTP_CAPTURE_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+// Binary capture of HTTP exchanges, replayed by CaptureReplay for deterministic performance runs.
+//
+// File: magic "ELCP", uint32 version, then records (integers little-endian, str = uint32 size + bytes):
+//   'Q' uint32 id, str method, str url, str body                                     request sent
+//   'C' uint32 id, uint64 at_us, str data                                            response chunk
+//   'E' uint32 id, uint64 at_us, uint32 status, str content_type, uint32 curl_code   response finished
+// at_us counts microseconds from the moment the request was sent.
+
+static const char     kCaptureMagic[4] = { 'E', 'L', 'C', 'P' };
+static const uint32_t kCaptureVersion = 1;
+
+struct CapturedChunk {
+    uint64_t    at_us = 0;
+    std::string data;
+};
+
+struct CapturedExchange {
+    std::string                method;
+    std::string                url;
+    std::string                body;
+    uint32_t                   status = 0;
+    std::string                content_type;
+    uint32_t                   curl_code = 0;
+    std::vector<CapturedChunk> chunks;
+};
+
+// Appends exchanges to a capture file. Thread-safe: sessions capturing to the same path share one
+// writer (see shared()), and each record carries the id of the request it belongs to.
+class CaptureWriter {
+public:
+    explicit CaptureWriter(const std::string& path) : file_{ path, std::ios::binary | std::ios::trunc } {
+        if (!file_) {
+            throw std::runtime_error("cannot open capture file: " + path);
+        }
+        file_.write(kCaptureMagic, sizeof(kCaptureMagic));
+        writeU32(kCaptureVersion);
+    }
+
+    // One writer per path for the whole process, so parallel clients do not truncate each other's capture
+    static std::shared_ptr<CaptureWriter> shared(const std::string& path) {
+        static std::mutex registry_mutex;
+        static std::map<std::string, std::weak_ptr<CaptureWriter>> registry;
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto writer = registry[path].lock();
+        if (!writer) {
+            writer = std::make_shared<CaptureWriter>(path);
+            registry[path] = writer;
+        }
+        return writer;
+    }
+
+    // Returns the id that the chunks and end of this request are recorded under
+    uint32_t beginRequest(const std::string& method, const std::string& url, const std::string& body) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint32_t id = next_id_++;
+        file_.put('Q');
+        writeU32(id);
+        writeString(method.data(), method.size());
+        writeString(url.data(), url.size());
+        writeString(body.data(), body.size());
+        return id;
+    }
+
+    // at_us: microseconds between sending the request and the chunk arriving
+    void chunk(uint32_t id, uint64_t at_us, const char* data, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        file_.put('C');
+        writeU32(id);
+        writeU64(at_us);
+        writeString(data, size);
+    }
+
+    void endRequest(uint32_t id, uint64_t at_us, uint32_t status, const std::string& content_type, uint32_t curl_code) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        file_.put('E');
+        writeU32(id);
+        writeU64(at_us);
+        writeU32(status);
+        writeString(content_type.data(), content_type.size());
+        writeU32(curl_code);
+        file_.flush();
+    }
+
+private:
+    std::ofstream file_;
+    std::mutex    mutex_;
+    uint32_t      next_id_ = 0;
+
+    void writeU32(uint32_t value) { file_.write(reinterpret_cast<const char*>(&value), sizeof(value)); }
+    void writeU64(uint64_t value) { file_.write(reinterpret_cast<const char*>(&value), sizeof(value)); }
+    void writeString(const char* data, size_t size) {
+        writeU32(static_cast<uint32_t>(size));
+        file_.write(data, static_cast<std::streamsize>(size));
+    }
+};
+
+// Loads every complete exchange in a capture file, in the order the requests were sent
+inline std::vector<CapturedExchange> readCapture(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("cannot open capture file: " + path);
+    }
+    char magic[4] = {};
+    uint32_t version = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (!in || std::string(magic, sizeof(magic)) != std::string(kCaptureMagic, sizeof(kCaptureMagic)) || version != kCaptureVersion) {
+        throw std::runtime_error("not a capture file: " + path);
+    }
+
+    const std::streamoff header_end = in.tellg();
+    in.seekg(0, std::ios::end);
+    const std::streamoff file_size = in.tellg();
+    in.seekg(header_end);
+
+    auto readU32 = [&in]() { uint32_t v = 0; in.read(reinterpret_cast<char*>(&v), sizeof(v)); return v; };
+    auto readU64 = [&in]() { uint64_t v = 0; in.read(reinterpret_cast<char*>(&v), sizeof(v)); return v; };
+    auto readString = [&in, &readU32, file_size]() {
+        const uint32_t size = readU32();
+        // a corrupt size must not turn into a huge allocation; no string can run past the end of the file
+        if (!in || static_cast<std::streamoff>(size) > file_size - in.tellg()) {
+            in.setstate(std::ios::failbit);
+            return std::string{};
+        }
+        std::string s(size, '\0');
+        in.read(&s[0], static_cast<std::streamsize>(s.size()));
+        return s;
+    };
+
+    std::vector<CapturedExchange> exchanges;
+    std::vector<bool> complete;
+    char tag = 0;
+    while (in.get(tag)) {
+        uint32_t id = readU32();
+        if (tag == 'Q' && id == exchanges.size()) {
+            // requests are numbered in the order they were written
+            exchanges.emplace_back();
+            complete.push_back(false);
+            exchanges[id].method = readString();
+            exchanges[id].url = readString();
+            exchanges[id].body = readString();
+        }
+        else if (tag == 'C' && id < exchanges.size()) {
+            CapturedChunk chunk;
+            chunk.at_us = readU64();
+            chunk.data = readString();
+            exchanges[id].chunks.emplace_back(std::move(chunk));
+        }
+        else if (tag == 'E' && id < exchanges.size()) {
+            readU64();
+            exchanges[id].status = readU32();
+            exchanges[id].content_type = readString();
+            exchanges[id].curl_code = readU32();
+            complete[id] = static_cast<bool>(in);
+        }
+        else {
+            break; // corrupt or truncated
+        }
+        if (!in) {
+            break;
+        }
+    }
+
+    // drop requests whose response never finished (e.g. the process was killed mid-capture)
+    std::vector<CapturedExchange> finished;
+    for (size_t i = 0; i < exchanges.size(); i++) {
+        if (complete[i]) {
+            finished.emplace_back(std::move(exchanges[i]));
+        }
+    }
+    return finished;
+}
+
+#endif // !HTTP_CAPTURE_HPP
@@ -0,0 +1,165 @@
+﻿/*****************************************************************//**
+ * \file   LatencyBench.cpp
+ * \brief  Checks LatencyController decisions against a local server that injects jitter
+ *
+ * Usage: LatencyBench
+ *
+ * Serves synthetic PCM streams on 127.0.0.1 with a chosen time to first
+ * byte, link bandwidth and random stalls, and runs a few utterances per
+ * scenario through TextToSpeech::stream() with the controller attached. A
+ * RenderDriver plays the audio on the device's schedule in place of
+ * PortAudio, so no sound card is needed. Each scenario starts a fresh
+ * controller and checks where it settled:
+ *   fast link        stays on pcm_24000, lowers optimize_streaming_latency
+ *   slow link        switches to pcm_16000
+ *   stalls           grows the prebuffer to ride them out
+ *   stalls, slow     switches to pcm_16000, prebuffer stops at its cap
+ *   slow first byte  raises optimize_streaming_latency
+ *   short utterance  keeps pcm_24000 with nothing measured
+ * Exits non-zero if any check fails, or if a stream does not finish.
+ *********************************************************************/
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <thread>
+#include "ElevenLabsAPI.hpp"
+#include "LoopbackHttp.hpp"
+
+// What the server does to every stream while a scenario runs
+struct Scenario {
+	const char* name;
+	double      ttfb_ms;
+	double      link_speed;        // bandwidth in multiples of what pcm_24000 needs to play in real time
+	double      stall_probability; // chance of a stall after each chunk
+	double      stall_ms;
+	int         audio_ms;          // length of each utterance
+	int         streams;
+	std::function<bool(const StreamParams&)> check;
+	const char* expectation;
+};
+
+static const size_t kChunkBytes = 4800; // 100 ms of pcm_24000
+
+static std::atomic<const Scenario*> current_scenario{ nullptr };
+
+// A stream still running after this has deadlocked (playback waiting on a paused transfer or the reverse)
+static const int64_t kStreamTimeoutMs = 30000;
+static std::atomic<int64_t> stream_deadline_ms{ INT64_MAX };
+
+static int64_t nowMs() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Streams one utterance of silence in the requested output format, paced by the current scenario
+static bool serveStream(socket_t s, const std::string& target, std::mt19937& random) {
+	const Scenario& scenario = *current_scenario.load();
+	size_t format = target.find("output_format=pcm_");
+	const int rate = format == std::string::npos ? 24000 : std::atoi(target.c_str() + format + 18);
+	size_t remaining = static_cast<size_t>(scenario.audio_ms) * static_cast<size_t>(rate) / 1000 * sizeof(int16_t);
+	const double chunk_ms = 1000.0 * kChunkBytes / (scenario.link_speed * 24000 * sizeof(int16_t));
+	std::bernoulli_distribution stall(scenario.stall_probability);
+
+	auto next = std::chrono::steady_clock::now() + std::chrono::microseconds(static_cast<int64_t>(scenario.ttfb_ms * 1000));
+	std::string pending = "HTTP/1.1 200 OK\r\nContent-Type: audio/pcm\r\nTransfer-Encoding: chunked\r\n\r\n";
+	const std::string audio(kChunkBytes, '\0');
+	while (remaining > 0) {
+		std::this_thread::sleep_until(next);
+		size_t size = (std::min)(remaining, kChunkBytes);
+		appendChunk(pending, audio.data(), size);
+		if (!sendAll(s, pending)) return false;
+		pending.clear();
+		remaining -= size;
+		double gap_ms = chunk_ms + (stall(random) ? scenario.stall_ms : 0.0);
+		next += std::chrono::microseconds(static_cast<int64_t>(gap_ms * 1000));
+	}
+	return sendAll(s, "0\r\n\r\n");
+}
+
+static void serveConnection(socket_t s) {
+	setNoDelay(s);
+	std::mt19937 random(7);
+	Connection connection(s);
+	HttpRequest request;
+	while (readRequest(connection, request) && serveStream(s, request.target, random) && request.keep_alive) {}
+	closeSocket(s);
+}
+
+int main()
+{
+	startSockets();
+	int port = 0;
+	socket_t listener = listenLoopback(0, port);
+	if (listener == INVALID_SOCKET) {
+		std::cerr << "cannot listen on loopback\n";
+		return 1;
+	}
+	std::thread([listener]() {
+		while (true) {
+			socket_t client = accept(listener, nullptr, nullptr);
+			if (client == INVALID_SOCKET) return;
+			std::thread(serveConnection, client).detach();
+		}
+	}).detach();
+
+	std::thread([]() {
+		while (nowMs() <= stream_deadline_ms.load()) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		}
+		std::cout << "   FAILED: a stream did not finish within " << kStreamTimeoutMs / 1000 << " s\nFAILED" << std::endl;
+		std::_Exit(1);
+	}).detach();
+
+	// the sound card
+	RenderDriver device;
+	AudioEngine& engine = AudioEngine::instance();
+
+	const Scenario scenarios[] = {
+		{ "fast link", 60.0, 8.0, 0.0, 0.0, 1500, 4,
+			[](const StreamParams& p) { return p.output_format == "pcm_24000" && p.optimize_streaming_latency <= 1; },
+			"pcm_24000, optimize_streaming_latency <= 1" },
+		{ "slow link", 60.0, 1.1, 0.0, 0.0, 1500, 3,
+			[](const StreamParams& p) { return p.output_format == "pcm_16000"; },
+			"pcm_16000" },
+		{ "stalls", 60.0, 10.0, 0.25, 250.0, 2500, 4,
+			[](const StreamParams& p) { return p.prebuffer_ms >= 150; },
+			"prebuffer >= 150 ms" },
+		{ "stalls, slow", 60.0, 1.3, 0.3, 300.0, 3000, 8,
+			[](const StreamParams& p) { return p.output_format == "pcm_16000" && p.prebuffer_ms == LatencyController::kMaxPrebufferMs; },
+			"pcm_16000, prebuffer at its cap" },
+		{ "slow first byte", 400.0, 8.0, 0.0, 0.0, 1000, 3,
+			[](const StreamParams& p) { return p.optimize_streaming_latency == 4; },
+			"optimize_streaming_latency = 4" },
+		{ "short utterance", 60.0, 1.1, 0.0, 0.0, 200, 1,
+			[](const StreamParams& p) { return p.output_format == "pcm_24000"; },
+			"pcm_24000" },
+	};
+
+	elevenlabs::ElevenLabs client("bench", "", true, "http://127.0.0.1:" + std::to_string(port) + "/v1/");
+	bool ok = true;
+	for (const Scenario& scenario : scenarios) {
+		std::cout << "== " << scenario.name << '\n';
+		current_scenario.store(&scenario);
+		LatencyController controller;
+		client.setLatencyController(&controller);
+		size_t underruns = 0;
+		for (int i = 0; i < scenario.streams; i++) {
+			StreamResponse response;
+			const size_t underruns_before = engine.underruns();
+			stream_deadline_ms.store(nowMs() + kStreamTimeoutMs);
+			client.text_to_speech.stream("bench", "bench", "eleven_turbo_v2", &response);
+			engine.drain(); // let it play out, so streams do not overlap
+			stream_deadline_ms.store(INT64_MAX);
+			underruns += engine.underruns() - underruns_before;
+		}
+		client.setLatencyController(nullptr);
+		const StreamParams settled = controller.params();
+		const bool passed = scenario.check(settled);
+		ok &= passed;
+		std::cout << (passed ? "   ok: " : "   FAILED: expected ") << scenario.expectation << " (" << underruns << " underruns)\n";
+	}
+
+	closeSocket(listener);
+	std::cout << (ok ? "OK" : "FAILED") << '\n';
+	return ok ? 0 : 1;
+}
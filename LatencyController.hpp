@@ -0,0 +1,142 @@
+#ifndef LATENCY_CONTROLLER_HPP
+#define LATENCY_CONTROLLER_HPP
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+#include <mutex>
+
+// What was measured over one stream
+struct StreamStats {
+    double ttfb_ms = 0.0;        // request start to first audio byte
+    double jitter_ms = 0.0;      // standard deviation of the gap between chunks
+    double max_gap_ms = 0.0;     // longest gap between chunks
+    double realtime_factor = 0.0; // seconds of audio received per second of transfer
+    size_t chunks = 0;
+    bool   throttled = false;    // playback fell behind the network; only arrivals before that were measured
+    size_t underruns = 0;        // audio callbacks that ran short while the stream was still producing
+};
+
+// Knobs for the next stream
+struct StreamParams {
+    int         optimize_streaming_latency = 3;
+    std::string output_format = "pcm_24000";
+    int         prebuffer_ms = 0;
+
+    int sampleRate() const { return std::stoi(output_format.substr(output_format.find('_') + 1)); }
+};
+
+struct LatencyTarget {
+    double time_to_first_audio_ms = 500.0;
+    double underruns_per_stream = 0.1; // glitch budget, averaged over recent streams
+};
+
+// Picks streaming parameters from what recent streams measured: the optimize_streaming_latency
+// level from time to first byte, a lower PCM rate when the link can barely keep up with real
+// time, and a playout prebuffer sized from inter-chunk jitter and underrun history. When the
+// glitch budget and the time-to-first-audio target conflict, glitches win.
+// Thread-safe, so clients streaming in parallel can share one controller.
+class LatencyController {
+public:
+    // Longest prebuffer the playback buffer can fill before it pauses the transfer (AudioEngine::kMaxPrebufferSamples)
+    static constexpr int kMaxPrebufferMs = 500;
+
+    explicit LatencyController(LatencyTarget target = LatencyTarget{}, bool log = true) : target_{ target }, log_{ log } {}
+
+    // A copy: another stream may record() while this one is using it
+    StreamParams params() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return params_;
+    }
+    const LatencyTarget& target() const { return target_; }
+
+    void record(const StreamStats& stats) {
+        if (stats.chunks == 0) {
+            return; // nothing measured (cache replay, failed request)
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        const double alpha = streams_ == 0 ? 1.0 : 0.3;
+        ttfb_ms_ += alpha * (stats.ttfb_ms - ttfb_ms_);
+        underruns_ += alpha * (static_cast<double>(stats.underruns) - underruns_);
+        if (stats.chunks >= 3) {
+            // a throttled stream may only have a handful of arrivals sampled; too few to say much
+            jitter_ms_ += alpha * (stats.jitter_ms - jitter_ms_);
+            if (stats.realtime_factor > 0.0) {
+                // the first real sample replaces the initial 0 rather than being averaged with it
+                realtime_factor_ += (realtime_samples_ == 0 ? 1.0 : 0.3) * (stats.realtime_factor - realtime_factor_);
+                realtime_samples_++;
+            }
+        }
+        streams_++;
+
+        std::ostringstream why;
+        const bool glitching = underruns_ > target_.underruns_per_stream;
+
+        // optimize_streaming_latency: trade some quality for first-byte time when it is eating the budget
+        if (ttfb_ms_ > 0.6 * target_.time_to_first_audio_ms && params_.optimize_streaming_latency < 4) {
+            params_.optimize_streaming_latency++;
+            why << " ttfb over 60% of target, raising latency optimisation;";
+        }
+        else if (ttfb_ms_ < 0.25 * target_.time_to_first_audio_ms && params_.optimize_streaming_latency > 0) {
+            params_.optimize_streaming_latency--;
+            why << " ttfb well under target, lowering latency optimisation;";
+        }
+
+        // output format: 16 kHz needs two thirds of the bandwidth of 24 kHz. Left alone until the
+        // bandwidth has actually been measured; short streams do not say anything about it.
+        const bool measured = realtime_samples_ > 0;
+        const int rate = params_.sampleRate();
+        const double factor_at_24k = realtime_factor_ * rate / 24000.0;
+        if (measured && rate == 24000 && realtime_factor_ < 1.25) {
+            params_.output_format = "pcm_16000";
+            why << " barely faster than real time, switching to pcm_16000;";
+        }
+        else if (measured && rate != 24000 && factor_at_24k > 1.5 && !glitching) {
+            params_.output_format = "pcm_24000";
+            why << " bandwidth recovered, switching back to pcm_24000;";
+        }
+
+        // prebuffer: cover typical jitter, grow while glitching, then fit into what is left of the TTFA budget
+        if (glitching) {
+            glitch_margin_ms_ = (std::min)(glitch_margin_ms_ * 1.5 + 40.0, static_cast<double>(kMaxPrebufferMs));
+            why << " underruns over budget, growing prebuffer;";
+        }
+        else {
+            glitch_margin_ms_ *= 0.8;
+        }
+        double prebuffer = 2.0 * jitter_ms_ + glitch_margin_ms_;
+        const double room = target_.time_to_first_audio_ms - ttfb_ms_;
+        if (prebuffer > room && !glitching) {
+            prebuffer = (std::max)(room, 0.0);
+            why << " prebuffer capped by time-to-first-audio target;";
+        }
+        params_.prebuffer_ms = static_cast<int>(std::clamp(prebuffer, 0.0, static_cast<double>(kMaxPrebufferMs)));
+
+        if (log_) {
+            std::ostringstream realtime;
+            if (measured) realtime << 'x' << realtime_factor_;
+            else realtime << "unknown";
+            std::cout << "[latency] ttfb " << static_cast<int>(ttfb_ms_) << " ms, jitter " << static_cast<int>(jitter_ms_)
+                << " ms, underruns " << underruns_ << "/stream, realtime " << realtime.str()
+                << " -> optimize_streaming_latency=" << params_.optimize_streaming_latency
+                << " output_format=" << params_.output_format
+                << " prebuffer=" << params_.prebuffer_ms << " ms" << why.str() << '\n';
+        }
+    }
+
+private:
+    mutable std::mutex mutex_;
+    LatencyTarget target_;
+    bool          log_;
+    StreamParams  params_;
+    size_t        streams_ = 0;
+    double        ttfb_ms_ = 0.0;
+    double        jitter_ms_ = 0.0;
+    double        underruns_ = 0.0;
+    double        realtime_factor_ = 0.0;
+    size_t        realtime_samples_ = 0; // streams that measured realtime_factor_
+    double        glitch_margin_ms_ = 0.0;
+};
+
+#endif // !LATENCY_CONTROLLER_HPP
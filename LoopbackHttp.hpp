@@ -0,0 +1,189 @@
+#ifndef LOOPBACK_HTTP_HPP
+#define LOOPBACK_HTTP_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <csignal>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Server side of HTTP/1.1 for the local test servers (CaptureReplay, LatencyBench): blocking sockets
+// on 127.0.0.1, one thread per connection, responses sent chunked.
+
+#ifdef _WIN32
+using socket_t = SOCKET;
+inline void closeSocket(socket_t s) { closesocket(s); }
+#else
+using socket_t = int;
+static const socket_t INVALID_SOCKET = -1;
+inline void closeSocket(socket_t s) { close(s); }
+#endif
+
+// Call once before opening sockets. A client that hangs up mid-response then only ends its own
+// connection instead of the process taking SIGPIPE.
+inline void startSockets() {
+#ifdef _WIN32
+    WSADATA wsa;
+    WSAStartup(MAKEWORD(2, 2), &wsa);
+#else
+    signal(SIGPIPE, SIG_IGN);
+#endif
+}
+
+// Listens on 127.0.0.1:port (0 picks a free port) and stores the port in bound_port; INVALID_SOCKET on failure
+inline socket_t listenLoopback(int port, int& bound_port) {
+    socket_t listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == INVALID_SOCKET) {
+        return INVALID_SOCKET;
+    }
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&one), sizeof(one));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    socklen_t address_size = sizeof(address);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 16) != 0
+        || getsockname(listener, reinterpret_cast<sockaddr*>(&address), &address_size) != 0) {
+        closeSocket(listener);
+        return INVALID_SOCKET;
+    }
+    bound_port = ntohs(address.sin_port);
+    return listener;
+}
+
+// Responses are written as they are produced; do not hold small chunks back
+inline void setNoDelay(socket_t s) {
+    int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+}
+
+inline bool sendAll(socket_t s, const char* data, size_t size) {
+    while (size > 0) {
+        int sent = send(s, data, static_cast<int>((std::min<size_t>)(size, 1 << 20)), 0);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+inline bool sendAll(socket_t s, const std::string& data) { return sendAll(s, data.data(), data.size()); }
+
+// Appends one chunk of a chunked response body
+inline void appendChunk(std::string& out, const char* data, size_t size) {
+    std::ostringstream chunk_size;
+    chunk_size << std::hex << size << "\r\n";
+    out += chunk_size.str();
+    out.append(data, size);
+    out += "\r\n";
+}
+
+// Buffered reader for one connection
+class Connection {
+public:
+    explicit Connection(socket_t s) : socket_{ s } {}
+
+    socket_t socket() const { return socket_; }
+
+    bool readLine(std::string& line) {
+        size_t end;
+        while ((end = buffer_.find("\r\n")) == std::string::npos) {
+            if (!fill()) return false;
+        }
+        line = buffer_.substr(0, end);
+        buffer_.erase(0, end + 2);
+        return true;
+    }
+
+    bool readExact(size_t size, std::string& out) {
+        while (buffer_.size() < size) {
+            if (!fill()) return false;
+        }
+        out.append(buffer_, 0, size);
+        buffer_.erase(0, size);
+        return true;
+    }
+
+private:
+    socket_t    socket_;
+    std::string buffer_;
+
+    bool fill() {
+        char chunk[16384];
+        int received = recv(socket_, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            return false;
+        }
+        buffer_.append(chunk, static_cast<size_t>(received));
+        return true;
+    }
+};
+
+struct HttpRequest {
+    std::string method;
+    std::string target;
+    std::string body;
+    bool        keep_alive = true;
+};
+
+inline std::string asciiLower(std::string text) {
+    for (char& c : text) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return text;
+}
+
+// Reads the next request on the connection, body included; false once the client is gone
+inline bool readRequest(Connection& connection, HttpRequest& request) {
+    std::string line;
+    if (!connection.readLine(line)) return false;
+    std::istringstream request_line(line);
+    std::string version;
+    request_line >> request.method >> request.target >> version;
+    request.body.clear();
+    request.keep_alive = version != "HTTP/1.0";
+
+    size_t content_length = 0;
+    bool chunked = false;
+    while (connection.readLine(line) && !line.empty()) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        size_t start = line.find_first_not_of(' ', colon + 1);
+        std::string name = asciiLower(line.substr(0, colon));
+        std::string value = start == std::string::npos ? "" : line.substr(start);
+        if (name == "content-length") content_length = static_cast<size_t>(std::strtoull(value.c_str(), nullptr, 10));
+        else if (name == "transfer-encoding") chunked = asciiLower(value).find("chunked") != std::string::npos;
+        else if (name == "connection") request.keep_alive = asciiLower(value) != "close";
+        else if (name == "expect" && asciiLower(value) == "100-continue") sendAll(connection.socket(), "HTTP/1.1 100 Continue\r\n\r\n");
+    }
+    if (!line.empty()) return false;
+
+    if (!chunked) {
+        return connection.readExact(content_length, request.body);
+    }
+    while (connection.readLine(line)) {
+        size_t size = static_cast<size_t>(std::strtoull(line.c_str(), nullptr, 16));
+        if (size == 0) {
+            while (connection.readLine(line) && !line.empty()) {} // trailers
+            return true;
+        }
+        if (!connection.readExact(size, request.body) || !connection.readLine(line)) return false;
+    }
+    return false;
+}
+
+#endif // !LOOPBACK_HTTP_HPP
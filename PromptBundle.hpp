@@ -0,0 +1,217 @@
+#ifndef PROMPT_BUNDLE_HPP
+#define PROMPT_BUNDLE_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <string_view>
+
+#include "MappedFile.hpp"
+
+// Packed prompt bundle: one file holding many rendered prompts, looked up by key.
+//
+// Layout (all integers little-endian):
+//   [header]  magic "ELPB", uint32 version, uint64 count, uint64 index_offset, uint64 keys_offset
+//   [data]    audio blobs, back to back
+//   [index]   count * BundleIndexEntry, sorted by key (bytewise)
+//   [keys]    key strings, each followed by its output format (e.g. "pcm_16000"), back to back
+// Version 1 bundles have no formats; their entries read back with an empty one.
+namespace elevenlabs {
+
+    static const char     kBundleMagic[4] = { 'E', 'L', 'P', 'B' };
+    static const uint32_t kBundleVersion = 2;
+
+#pragma pack(push, 1)
+    struct BundleHeader {
+        char     magic[4];
+        uint32_t version;
+        uint64_t count;
+        uint64_t index_offset;
+        uint64_t keys_offset;
+    };
+
+    struct BundleIndexEntry {
+        uint64_t key_offset;   // relative to keys_offset
+        uint32_t key_size;
+        uint32_t format_size;  // format string follows the key; 0 in version 1
+        uint64_t data_offset;  // absolute file offset
+        uint64_t data_size;
+    };
+#pragma pack(pop)
+
+    // Non-owning view of an audio blob inside a mapped bundle
+    struct AudioView {
+        const uint8_t*   data = nullptr;
+        size_t           size = 0;
+        std::string_view format; // output_format it was rendered in, empty if the bundle predates formats
+
+        bool empty() const { return data == nullptr; }
+
+        // Raw 16-bit PCM that enqueueAudio() can play; anything else (mp3, ulaw...) needs decoding first
+        bool isPcm() const { return format.empty() || format.substr(0, 4) == "pcm_"; }
+
+        // Sample rate from the format name, e.g. 16000 for "pcm_16000"; 24000 when the format is not recorded
+        int sampleRate() const {
+            int rate = 0;
+            size_t underscore = format.find('_');
+            if (underscore != std::string_view::npos) {
+                for (char c : format.substr(underscore + 1)) {
+                    if (c < '0' || c > '9') break;
+                    rate = rate * 10 + (c - '0');
+                }
+            }
+            return rate > 0 ? rate : 24000;
+        }
+    };
+
+    // Writes a bundle incrementally: audio goes straight to disk, only the index is kept in memory
+    class PromptBundleWriter {
+    public:
+        explicit PromptBundleWriter(const std::string& path) : file_{ path, std::ios::binary | std::ios::trunc } {
+            if (!file_) {
+                throw std::runtime_error("cannot open bundle for writing: " + path);
+            }
+            BundleHeader header{};
+            file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            offset_ = sizeof(header);
+        }
+
+        void add(const std::string& key, const void* data, size_t size, const std::string& format = "pcm_24000") {
+            entries_.push_back({ key, format, offset_, size });
+            file_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            offset_ += size;
+        }
+
+        void add(const std::string& key, const std::string& data, const std::string& format = "pcm_24000") { add(key, data.data(), data.size(), format); }
+
+        void finish() {
+            std::sort(entries_.begin(), entries_.end(), [](const Pending& a, const Pending& b) { return a.key < b.key; });
+            for (size_t i = 1; i < entries_.size(); i++) {
+                if (entries_[i].key == entries_[i - 1].key) {
+                    throw std::runtime_error("duplicate key in bundle: " + entries_[i].key);
+                }
+            }
+
+            BundleHeader header{};
+            std::memcpy(header.magic, kBundleMagic, sizeof(kBundleMagic));
+            header.version = kBundleVersion;
+            header.count = entries_.size();
+            header.index_offset = offset_;
+            header.keys_offset = offset_ + entries_.size() * sizeof(BundleIndexEntry);
+
+            uint64_t key_offset = 0;
+            for (const auto& entry : entries_) {
+                BundleIndexEntry index{};
+                index.key_offset = key_offset;
+                index.key_size = static_cast<uint32_t>(entry.key.size());
+                index.format_size = static_cast<uint32_t>(entry.format.size());
+                index.data_offset = entry.data_offset;
+                index.data_size = entry.data_size;
+                file_.write(reinterpret_cast<const char*>(&index), sizeof(index));
+                key_offset += entry.key.size() + entry.format.size();
+            }
+            for (const auto& entry : entries_) {
+                file_.write(entry.key.data(), static_cast<std::streamsize>(entry.key.size()));
+                file_.write(entry.format.data(), static_cast<std::streamsize>(entry.format.size()));
+            }
+
+            file_.seekp(0);
+            file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file_.close();
+            if (file_.fail()) {
+                throw std::runtime_error("failed writing bundle");
+            }
+        }
+
+    private:
+        struct Pending {
+            std::string key;
+            std::string format;
+            uint64_t    data_offset;
+            uint64_t    data_size;
+        };
+
+        std::ofstream        file_;
+        uint64_t             offset_ = 0;
+        std::vector<Pending> entries_;
+    };
+
+    // Read-only, memory-mapped bundle. Lookups are a binary search over the index, results point into the mapping.
+    class PromptBundle {
+    public:
+        explicit PromptBundle(const std::string& path) : file_{ path }, base_{ file_.data() }, length_{ file_.size() } {
+            validate();
+        }
+
+        PromptBundle(const PromptBundle&) = delete;
+        PromptBundle& operator=(const PromptBundle&) = delete;
+
+        size_t size() const { return static_cast<size_t>(header()->count); }
+
+        std::string_view key(size_t i) const {
+            const auto& entry = index()[i];
+            return { reinterpret_cast<const char*>(base_ + header()->keys_offset + entry.key_offset), entry.key_size };
+        }
+
+        AudioView audio(size_t i) const {
+            const auto& entry = index()[i];
+            const char* format = reinterpret_cast<const char*>(base_ + header()->keys_offset + entry.key_offset + entry.key_size);
+            const size_t format_size = header()->version == 1 ? 0 : entry.format_size;
+            return { base_ + entry.data_offset, static_cast<size_t>(entry.data_size), { format, format_size } };
+        }
+
+        // Returns an empty view if the key is not in the bundle
+        AudioView find(std::string_view wanted) const {
+            size_t lo = 0, hi = size();
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (key(mid) < wanted) {
+                    lo = mid + 1;
+                }
+                else {
+                    hi = mid;
+                }
+            }
+            if (lo < size() && key(lo) == wanted) {
+                return audio(lo);
+            }
+            return {};
+        }
+
+        bool contains(std::string_view wanted) const { return !find(wanted).empty(); }
+
+    private:
+        MappedFile     file_;
+        const uint8_t* base_;
+        size_t         length_;
+
+        const BundleHeader* header() const { return reinterpret_cast<const BundleHeader*>(base_); }
+        const BundleIndexEntry* index() const { return reinterpret_cast<const BundleIndexEntry*>(base_ + header()->index_offset); }
+
+        void validate() {
+            const auto* h = header();
+            bool ok = length_ >= sizeof(BundleHeader)
+                && std::memcmp(h->magic, kBundleMagic, sizeof(kBundleMagic)) == 0
+                && (h->version == kBundleVersion || h->version == 1)
+                && h->index_offset <= length_
+                && h->count <= (length_ - h->index_offset) / sizeof(BundleIndexEntry)
+                && h->keys_offset == h->index_offset + h->count * sizeof(BundleIndexEntry)
+                && h->keys_offset <= length_;
+            for (size_t i = 0; ok && i < h->count; i++) {
+                const auto& entry = index()[i];
+                ok = entry.data_offset <= h->index_offset && entry.data_size <= h->index_offset - entry.data_offset
+                    && entry.key_offset <= length_ - h->keys_offset
+                    && uint64_t{ entry.key_size } + (h->version == 1 ? 0 : entry.format_size) <= length_ - h->keys_offset - entry.key_offset;
+            }
+            if (!ok) {
+                throw std::runtime_error("not a valid prompt bundle");
+            }
+        }
+    };
+
+} // namespace elevenlabs
+#endif // !PROMPT_BUNDLE_HPP
@@ -0,0 +1,244 @@
+﻿/*****************************************************************//**
+ * \file   PromptRenderer.cpp
+ * \brief  Offline renderer that turns a prompt manifest into a packed bundle
+ *
+ * Usage: PromptRenderer <manifest.jsonl> <output.bundle> [jobs]
+ *
+ * Each manifest line is a JSON object:
+ *   {"key": "...", "text": "...", "voice_id": "...", "model_id": "...",
+ *    "voice_settings": {...}, "output_format": "pcm_24000"}
+ * Only "key", "text" and "voice_id" are required.
+ *
+ * Finished items are appended to <output.bundle>.journal as they complete,
+ * so an interrupted run picks up where it left off without paying for
+ * the same prompt twice. An item whose text, voice, model, settings or
+ * format changed since it was journaled is rendered again. The bundle
+ * itself is only written once every item has been rendered.
+ *********************************************************************/
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <set>
+#include <thread>
+#include "ElevenLabsAPI.hpp"
+#include "PromptBundle.hpp"
+
+struct PromptItem {
+	std::string key;
+	std::string text;
+	std::string voice_id;
+	std::string model_id = "eleven_turbo_v2";
+	std::string output_format = "pcm_24000";
+	Json voice_settings;
+
+	// Hash of everything that shapes the audio, so a journaled render is only reused for the same request
+	std::string spec() const {
+		return AudioCache::makeKey(text + '\0' + voice_id + '\0' + model_id + '\0' + voice_settings.dump() + '\0' + output_format);
+	}
+};
+
+// Journal: magic "ELRJ", then records of uint32 key size, key, spec (16 hex digits), uint64 audio size, audio
+class RenderJournal {
+public:
+	explicit RenderJournal(const std::string& path) : path_{ path } {}
+
+	// Returns the spec each key was last rendered with and drops a torn record left by a crash.
+	// A journal from an older format is discarded.
+	std::map<std::string, std::string> recover() {
+		std::map<std::string, std::string> done;
+		const std::streamoff size = fileSize();
+		std::ifstream in(path_, std::ios::binary);
+		char magic[sizeof(kMagic)] = {};
+		std::streamoff good_end = 0;
+		if (in.read(magic, sizeof(magic)) && std::equal(magic, magic + sizeof(magic), kMagic)) {
+			good_end = sizeof(kMagic);
+			std::string key;
+			std::string spec(kSpecSize, '\0');
+			uint32_t key_size = 0;
+			uint64_t audio_size = 0;
+			while (in.read(reinterpret_cast<char*>(&key_size), sizeof(key_size))) {
+				key.resize(key_size);
+				if (!in.read(&key[0], key_size)) break;
+				if (!in.read(&spec[0], kSpecSize)) break;
+				if (!in.read(reinterpret_cast<char*>(&audio_size), sizeof(audio_size))) break;
+				std::streamoff end = in.tellg() + static_cast<std::streamoff>(audio_size);
+				if (end > size || !in.seekg(end)) break;
+				good_end = end;
+				done[key] = spec; // a later record for the same key supersedes an earlier one
+			}
+		}
+		in.close();
+		truncate(good_end);
+		out_.open(path_, std::ios::binary | std::ios::app);
+		if (!out_) {
+			throw std::runtime_error("cannot open journal: " + path_);
+		}
+		if (good_end == 0) {
+			out_.write(kMagic, sizeof(kMagic));
+			out_.flush();
+		}
+		return done;
+	}
+
+	void append(const std::string& key, const std::string& spec, const std::string& audio) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		uint32_t key_size = static_cast<uint32_t>(key.size());
+		uint64_t audio_size = audio.size();
+		out_.write(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+		out_.write(key.data(), key_size);
+		out_.write(spec.data(), kSpecSize);
+		out_.write(reinterpret_cast<const char*>(&audio_size), sizeof(audio_size));
+		out_.write(audio.data(), static_cast<std::streamsize>(audio.size()));
+		out_.flush();
+	}
+
+	// Streams the journal records that match the manifest into the bundle, one record in memory at a time
+	void copyTo(elevenlabs::PromptBundleWriter& writer, std::map<std::string, const PromptItem*> items) {
+		out_.close();
+		std::ifstream in(path_, std::ios::binary);
+		in.seekg(sizeof(kMagic));
+		std::string key, audio;
+		std::string spec(kSpecSize, '\0');
+		uint32_t key_size = 0;
+		uint64_t audio_size = 0;
+		while (in.read(reinterpret_cast<char*>(&key_size), sizeof(key_size))) {
+			key.resize(key_size);
+			in.read(&key[0], key_size);
+			in.read(&spec[0], kSpecSize);
+			in.read(reinterpret_cast<char*>(&audio_size), sizeof(audio_size));
+			audio.resize(static_cast<size_t>(audio_size));
+			in.read(&audio[0], static_cast<std::streamsize>(audio_size));
+			auto it = items.find(key);
+			if (it != items.end() && it->second->spec() == spec) {
+				writer.add(key, audio, it->second->output_format);
+				items.erase(it); // stale renders of the same key may come before or after
+			}
+		}
+	}
+
+	void remove() { std::remove(path_.c_str()); }
+
+private:
+	static constexpr char   kMagic[4] = { 'E', 'L', 'R', 'J' };
+	static constexpr size_t kSpecSize = 16;
+
+	std::string   path_;
+	std::ofstream out_;
+	std::mutex    mutex_;
+
+	std::streamoff fileSize() {
+		std::ifstream in(path_, std::ios::binary | std::ios::ate);
+		return in ? static_cast<std::streamoff>(in.tellg()) : 0;
+	}
+
+	void truncate(std::streamoff size) {
+		if (size != fileSize()) {
+			std::filesystem::resize_file(path_, static_cast<std::uintmax_t>(size));
+		}
+	}
+};
+
+static std::vector<PromptItem> readManifest(const std::string& path) {
+	std::ifstream in(path);
+	if (!in) {
+		throw std::runtime_error("cannot open manifest: " + path);
+	}
+	std::vector<PromptItem> items;
+	std::set<std::string> keys;
+	std::string line;
+	size_t line_number = 0;
+	while (std::getline(in, line)) {
+		line_number++;
+		if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+		Json json = Json::parse(line);
+		PromptItem item;
+		item.key = json.at("key").get<std::string>();
+		item.text = json.at("text").get<std::string>();
+		item.voice_id = json.at("voice_id").get<std::string>();
+		item.model_id = json.value("model_id", item.model_id);
+		item.output_format = json.value("output_format", item.output_format);
+		if (json.count("voice_settings")) {
+			item.voice_settings = json.at("voice_settings");
+		}
+		if (!keys.insert(item.key).second) {
+			throw std::runtime_error("duplicate key '" + item.key + "' on manifest line " + std::to_string(line_number));
+		}
+		items.emplace_back(item);
+	}
+	return items;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3) {
+		std::cerr << "Usage: " << argv[0] << " <manifest.jsonl> <output.bundle> [jobs]\n";
+		return 2;
+	}
+	const std::string manifest_path = argv[1];
+	const std::string bundle_path = argv[2];
+	const size_t jobs = argc > 3 ? std::max(1, std::atoi(argv[3])) : 4;
+
+	try {
+		auto items = readManifest(manifest_path);
+		RenderJournal journal(bundle_path + ".journal");
+		auto done = journal.recover();
+
+		std::map<std::string, const PromptItem*> by_key;
+		std::vector<const PromptItem*> pending;
+		for (const auto& item : items) {
+			by_key[item.key] = &item;
+			auto it = done.find(item.key);
+			if (it == done.end() || it->second != item.spec()) {
+				pending.push_back(&item);
+			}
+		}
+		std::cout << items.size() << " prompts, " << items.size() - pending.size() << " already rendered, " << pending.size() << " to go\n";
+
+		// one client (and curl handle) per worker so requests run on parallel connections
+		std::vector<std::unique_ptr<elevenlabs::ElevenLabs>> clients;
+		for (size_t i = 0; i < std::min(jobs, pending.size()); i++) {
+			clients.emplace_back(new elevenlabs::ElevenLabs());
+		}
+
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> failed{ 0 };
+		std::mutex log_mutex;
+		std::vector<std::thread> workers;
+		for (auto& client : clients) {
+			workers.emplace_back([&, client = client.get()]() {
+				for (size_t i = next++; i < pending.size(); i = next++) {
+					const PromptItem& item = *pending[i];
+					try {
+						auto audio = client->text_to_speech.convert(item.text, item.voice_id, item.model_id, item.voice_settings, item.output_format);
+						journal.append(item.key, item.spec(), audio);
+					}
+					catch (const std::exception& e) {
+						failed++;
+						std::lock_guard<std::mutex> lock(log_mutex);
+						std::cerr << "Failed to render '" << item.key << "': " << e.what() << '\n';
+					}
+				}
+			});
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+
+		if (failed > 0) {
+			std::cerr << failed << " prompts failed, rerun to retry them\n";
+			return 1;
+		}
+
+		elevenlabs::PromptBundleWriter writer(bundle_path);
+		journal.copyTo(writer, by_key);
+		writer.finish();
+		journal.remove();
+		std::cout << "Wrote " << items.size() << " prompts to " << bundle_path << '\n';
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
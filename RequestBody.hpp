@@ -0,0 +1,196 @@
+#ifndef REQUEST_BODY_HPP
+#define REQUEST_BODY_HPP
+
+#include <array>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+// Text-to-speech request bodies written straight into a reusable buffer, without building a JSON DOM.
+// The output is byte-identical to nlohmann::json::dump() of the same object (keys sorted, same string
+// escaping), so audio cache keys derived from the body do not change.
+namespace elevenlabs {
+
+    // voice_settings sent by stream() and streamToCall()
+    static const char kDefaultStreamVoiceSettings[] = "{\"similarity_boost\":0.75,\"stability\":0.5,\"style\":0.0,\"use_speaker_boost\":true}";
+
+    namespace detail {
+        // Word-at-a-time tests over 8 bytes (SWAR); each is non-zero iff some byte matches
+        inline uint64_t loadWord(const char* p) {
+            uint64_t word;
+            std::memcpy(&word, p, sizeof(word));
+            return word;
+        }
+        inline uint64_t bytesEqual(uint64_t word, unsigned char c) {
+            uint64_t x = word ^ (0x0101010101010101ull * c);
+            return (x - 0x0101010101010101ull) & ~x & 0x8080808080808080ull;
+        }
+        inline uint64_t bytesBelow(uint64_t word, unsigned char c) {
+            return (word - 0x0101010101010101ull * c) & ~word & 0x8080808080808080ull;
+        }
+        inline bool allAscii(uint64_t word) { return (word & 0x8080808080808080ull) == 0; }
+
+        // Control characters, '"' and '\\'; bytes of multi-byte UTF-8 sequences never match
+        inline bool needsEscape(uint64_t word) {
+            return (bytesBelow(word, 0x20) | bytesEqual(word, '"') | bytesEqual(word, '\\')) != 0;
+        }
+
+        // RFC 3629 UTF-8 as a DFA, one table load per byte: no overlongs, surrogates or code points past U+10FFFF
+        enum Utf8State : uint8_t { kAccept, kTail1, kTail2, kTail3, kAfterE0, kAfterED, kAfterF0, kAfterF4, kReject, kUtf8States };
+
+        inline const std::array<uint8_t, kUtf8States * 256>& utf8Transitions() {
+            static const auto table = []() {
+                std::array<uint8_t, kUtf8States * 256> t;
+                t.fill(kReject);
+                auto range = [&t](Utf8State from, int low, int high, Utf8State to) {
+                    for (int b = low; b <= high; b++) t[from * 256 + b] = to;
+                };
+                range(kAccept, 0x00, 0x7F, kAccept);
+                range(kAccept, 0xC2, 0xDF, kTail1);
+                range(kAccept, 0xE0, 0xE0, kAfterE0);
+                range(kAccept, 0xE1, 0xEC, kTail2);
+                range(kAccept, 0xED, 0xED, kAfterED);
+                range(kAccept, 0xEE, 0xEF, kTail2);
+                range(kAccept, 0xF0, 0xF0, kAfterF0);
+                range(kAccept, 0xF1, 0xF3, kTail3);
+                range(kAccept, 0xF4, 0xF4, kAfterF4);
+                range(kTail1, 0x80, 0xBF, kAccept);
+                range(kTail2, 0x80, 0xBF, kTail1);
+                range(kTail3, 0x80, 0xBF, kTail2);
+                range(kAfterE0, 0xA0, 0xBF, kTail1);
+                range(kAfterED, 0x80, 0x9F, kTail1);
+                range(kAfterF0, 0x90, 0xBF, kTail2);
+                range(kAfterF4, 0x80, 0x8F, kTail2);
+                return t;
+            }();
+            return table;
+        }
+
+        // Bytes JSON needs escaped: control characters, '"' and '\\'. 0 means copy as is, otherwise the
+        // character after the backslash ('u' for \u00XX).
+        inline const std::array<char, 256>& escapes() {
+            static const auto table = []() {
+                std::array<char, 256> t{};
+                for (int c = 0; c < 0x20; c++) t[c] = 'u';
+                t['\b'] = 'b';
+                t['\f'] = 'f';
+                t['\n'] = 'n';
+                t['\r'] = 'r';
+                t['\t'] = 't';
+                t['"'] = '"';
+                t['\\'] = '\\';
+                return t;
+            }();
+            return table;
+        }
+
+        // Writes the escape for c at out, returns the position after it
+        inline char* writeEscape(char* out, unsigned char c, char kind) {
+            static const char hex[] = "0123456789abcdef";
+            *out++ = '\\';
+            *out++ = kind;
+            if (kind == 'u') {
+                *out++ = '0';
+                *out++ = '0';
+                *out++ = hex[c >> 4];
+                *out++ = hex[c & 0x0F];
+            }
+            return out;
+        }
+    } // namespace detail
+
+    // Appends text as a quoted JSON string, validating UTF-8 and escaping in one pass. Words of eight
+    // bytes that are plain ASCII with nothing to escape are skipped with a few integer operations;
+    // other words go byte by byte through the UTF-8 DFA and escape table. Runs are copied in one go.
+    // Throws std::runtime_error if text is not valid UTF-8.
+    inline void appendJsonString(std::string& out, std::string_view text) {
+        const auto& transitions = detail::utf8Transitions();
+        const auto& escapes = detail::escapes();
+        const char* s = text.data();
+        const size_t n = text.size();
+
+        // written through a pointer, then trimmed; room for the text unescaped, grown before a block that
+        // might not fit (an escape is at most six bytes)
+        const size_t base = out.size();
+        out.resize(base + n + 64);
+        char* dst = &out[base];
+        *dst++ = '"';
+
+        uint8_t state = detail::kAccept;
+        size_t copied = 0; // everything before this has been written to dst
+        size_t i = 0;
+        while (i < n) {
+            if (state == detail::kAccept) {
+                while (i + 8 <= n) {
+                    const uint64_t word = detail::loadWord(s + i);
+                    if (!detail::allAscii(word) || detail::needsEscape(word)) {
+                        break;
+                    }
+                    i += 8;
+                }
+            }
+            const size_t stop = (std::min)(i + 8, n);
+            const size_t written = static_cast<size_t>(dst - out.data());
+            const size_t needed = written + (n - copied) + 6 * (stop - i) + 1;
+            if (needed > out.size()) {
+                out.resize((std::max)(needed, 2 * out.size()));
+                dst = &out[written];
+            }
+            for (; i < stop; i++) {
+                const unsigned char c = static_cast<unsigned char>(s[i]);
+                state = transitions[state * 256 + c];
+                if (escapes[c] != 0) {
+                    std::memcpy(dst, s + copied, i - copied);
+                    dst = detail::writeEscape(dst + (i - copied), c, escapes[c]);
+                    copied = i + 1;
+                }
+            }
+            if (state == detail::kReject) {
+                break; // reject is absorbing, so checking once per block is enough
+            }
+        }
+        if (state != detail::kAccept) {
+            out.resize(base);
+            throw std::runtime_error("request text is not valid UTF-8");
+        }
+        std::memcpy(dst, s + copied, n - copied);
+        dst += n - copied;
+        *dst++ = '"';
+        out.resize(static_cast<size_t>(dst - out.data()));
+    }
+
+    // Builds {"model_id":...,"text":...,"voice_settings":...} in a buffer that is reused across requests
+    class SynthesisRequestWriter {
+    public:
+        // voice_settings is an already serialised JSON object, or empty to leave the field out.
+        // The returned body stays valid until the next call.
+        const std::string& write(std::string_view text, std::string_view model_id, std::string_view voice_settings = {}) {
+            buffer_.clear();
+            buffer_.reserve(text.size() + model_id.size() + voice_settings.size() + 192);
+            buffer_ += "{\"model_id\":";
+            appendJsonString(buffer_, model_id);
+            buffer_ += ",\"text\":";
+            appendJsonString(buffer_, text);
+            if (!voice_settings.empty()) {
+                buffer_ += ",\"voice_settings\":";
+                buffer_ += voice_settings;
+            }
+            buffer_ += '}';
+            return buffer_;
+        }
+
+        // One writer per thread, so each request body reuses the last one's allocation
+        static SynthesisRequestWriter& forThread() {
+            thread_local SynthesisRequestWriter writer;
+            return writer;
+        }
+
+    private:
+        std::string buffer_;
+    };
+
+} // namespace elevenlabs
+#endif // !REQUEST_BODY_HPP
@@ -0,0 +1,100 @@
+﻿/*****************************************************************//**
+ * \file   RequestBodyBench.cpp
+ * \brief  Benchmark of SynthesisRequestWriter against nlohmann::json
+ *
+ * Usage: RequestBodyBench
+ *
+ * For texts of 100 B to 50 KB (plain ASCII, dialogue with quotes and
+ * newlines, and multilingual UTF-8), builds the stream() request body the
+ * old way (json DOM + dump()) and with SynthesisRequestWriter, checks the
+ * two are byte-identical and reports the time per request of each.
+ * Exits non-zero if any body differs or invalid UTF-8 is not rejected.
+ *********************************************************************/
+#include <chrono>
+#include <cstdio>
+#include <nlohmann/json.hpp>
+#include "RequestBody.hpp"
+
+using Json = nlohmann::json;
+using elevenlabs::SynthesisRequestWriter;
+
+static std::string makeText(const std::string& pattern, size_t size) {
+	std::string text;
+	while (text.size() < size) text += pattern;
+	// cut on a character boundary so the text stays valid UTF-8
+	size_t end = size;
+	while (end > 0 && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) end--;
+	return text.substr(0, end);
+}
+
+// The body stream() used to build
+static std::string domBody(const std::string& text, const std::string& model_id) {
+	Json json;
+	json["text"] = text;
+	json["model_id"] = model_id;
+	Json voice_settings;
+	voice_settings["similarity_boost"] = 0.75;
+	voice_settings["stability"] = 0.5;
+	voice_settings["style"] = 0.0;
+	voice_settings["use_speaker_boost"] = true;
+	json["voice_settings"] = voice_settings;
+	return json.dump();
+}
+
+template <typename Build>
+static double nanosecondsPerRequest(size_t iterations, Build build) {
+	size_t sink = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < iterations; i++) {
+		sink += build();
+	}
+	double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	if (sink == 0) std::printf(" ");
+	return elapsed / iterations;
+}
+
+int main()
+{
+	const std::string model_id = "eleven_turbo_v2";
+	const std::pair<const char*, std::string> kinds[] = {
+		{ "ascii", "The quick brown fox jumps over the lazy dog, then settles down for a long nap in the sun. " },
+		{ "dialogue", "\"Are you coming?\" she asked.\n\t\"In a minute,\" he said \\ waving.\r\n" },
+		{ "utf-8", "Grüße aus Zürich! こんにちは世界。Привет, мир. 🎧 Ça va? " },
+	};
+	const size_t sizes[] = { 100, 1000, 10000, 50000 };
+	bool ok = true;
+
+	// every ASCII byte, including all control characters
+	std::string all_ascii;
+	for (int c = 1; c < 128; c++) all_ascii += static_cast<char>(c);
+	ok &= SynthesisRequestWriter().write(all_ascii, model_id, elevenlabs::kDefaultStreamVoiceSettings) == domBody(all_ascii, model_id);
+
+	// malformed UTF-8 must be rejected, as dump() does
+	const char* invalid[] = { "\xC0\xAF", "\xE0\x80\xAF", "\xED\xA0\x80", "\xF4\x90\x80\x80", "abc\xE2\x82", "\x80" };
+	for (const char* text : invalid) {
+		bool writer_threw = false, dom_threw = false;
+		try { SynthesisRequestWriter().write(text, model_id); } catch (const std::runtime_error&) { writer_threw = true; }
+		try { domBody(text, model_id); } catch (const Json::exception&) { dom_threw = true; }
+		ok &= writer_threw && dom_threw;
+	}
+
+	std::printf("%-9s %7s %14s %14s %8s\n", "text", "bytes", "json ns/req", "writer ns/req", "speedup");
+	SynthesisRequestWriter writer;
+	for (const auto& kind : kinds) {
+		for (size_t size : sizes) {
+			const std::string text = makeText(kind.second, size);
+			const bool same = writer.write(text, model_id, elevenlabs::kDefaultStreamVoiceSettings) == domBody(text, model_id);
+			ok &= same;
+
+			const size_t iterations = std::max<size_t>(20, 20000000 / (size + 100));
+			double dom_ns = nanosecondsPerRequest(iterations, [&]() { return domBody(text, model_id).size(); });
+			double writer_ns = nanosecondsPerRequest(iterations, [&]() {
+				return writer.write(text, model_id, elevenlabs::kDefaultStreamVoiceSettings).size();
+			});
+			std::printf("%-9s %7zu %14.0f %14.0f %7.1fx%s\n", kind.first, text.size(), dom_ns, writer_ns, dom_ns / writer_ns, same ? "" : "  MISMATCH");
+		}
+	}
+
+	std::printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
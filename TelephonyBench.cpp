@@ -0,0 +1,240 @@
+﻿/*****************************************************************//**
+ * \file   TelephonyBench.cpp
+ * \brief  Benchmark and loopback check for the telephony sink
+ *
+ * Usage: TelephonyBench [calls] [seconds] [ulaw|alaw]
+ *
+ * 1. Times the conversion kernels (pcm_24000 -> 8 kHz resample, G.711
+ *    encode) and reports how many real-time calls one core could convert.
+ * 2. Sends [calls] concurrent calls of pcm_24000 through a TelephonySink
+ *    to a UDP receiver on 127.0.0.1 for [seconds]. The receiver checks
+ *    every RTP stream (payload type, sequence numbers, timestamps step
+ *    by 160) and reports packet rate, interarrival jitter and CPU time.
+ *    It also decodes each stream's payload and measures the 1 kHz tone
+ *    (must come through within 1 dB) and the 6 kHz tone, which the
+ *    decimation filter must remove (it would alias to 2 kHz).
+ * Exits non-zero if any stream was malformed, lost packets, underran or
+ * failed the payload check.
+ *********************************************************************/
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include "TelephonySink.hpp"
+
+static const double kPi = 3.14159265358979323846;
+static const double kInBandHz = 1000.0;
+static const double kInBandLevel = 12000.0;
+static const double kOutOfBandHz = 6000.0;  // above the telephone band; aliases to 2 kHz if not filtered
+static const double kOutOfBandLevel = 4000.0;
+
+// 24 kHz test signal: a tone in the telephone band plus one above it that the filter must remove.
+// Both complete whole cycles every 100 ms, so a 2400-sample chunk repeats seamlessly.
+static std::vector<int16_t> testSignal(size_t samples) {
+	std::vector<int16_t> signal(samples);
+	for (size_t i = 0; i < samples; i++) {
+		double t = static_cast<double>(i) / 24000.0;
+		signal[i] = static_cast<int16_t>(kInBandLevel * std::sin(2.0 * kPi * kInBandHz * t) + kOutOfBandLevel * std::sin(2.0 * kPi * kOutOfBandHz * t));
+	}
+	return signal;
+}
+
+// Amplitude of the frequency component at hz in 8 kHz audio (one DFT bin)
+static double toneLevel(const std::vector<int16_t>& samples, double hz) {
+	double re = 0.0, im = 0.0;
+	for (size_t i = 0; i < samples.size(); i++) {
+		double phase = 2.0 * kPi * hz * static_cast<double>(i) / kTelephonyRate;
+		re += samples[i] * std::cos(phase);
+		im -= samples[i] * std::sin(phase);
+	}
+	return 2.0 * std::sqrt(re * re + im * im) / static_cast<double>(samples.size());
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void benchmarkKernels(G711::Law law) {
+	const size_t seconds = 60;
+	std::vector<int16_t> input = testSignal(24000 * seconds);
+	std::vector<int16_t> narrow;
+	narrow.reserve(8000 * seconds);
+	std::vector<uint8_t> encoded(8000 * seconds);
+
+	TelephonyResampler resampler(24000);
+	auto start = std::chrono::steady_clock::now();
+	for (size_t offset = 0; offset < input.size(); offset += 4800) { // 200 ms network chunks
+		resampler.process(input.data() + offset, std::min<size_t>(4800, input.size() - offset), narrow);
+	}
+	double resample_s = secondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	G711::encode(law, narrow.data(), narrow.size(), encoded.data());
+	double encode_s = secondsSince(start);
+
+	double per_call = (resample_s + encode_s) / seconds; // CPU seconds per second of call audio
+	std::printf("kernels: %zu s of pcm_24000 -> %zu samples at 8 kHz\n", seconds, narrow.size());
+	std::printf("  resample %.2f ns/sample, encode %.2f ns/sample, %.0f real-time calls per core\n",
+		resample_s * 1e9 / narrow.size(), encode_s * 1e9 / narrow.size(), 1.0 / per_call);
+}
+
+// What the receiver saw of one RTP stream
+struct ReceivedStream {
+	size_t   packets = 0;
+	size_t   malformed = 0;
+	size_t   lost = 0;
+	size_t   markers = 0;
+	uint16_t last_sequence = 0;
+	uint32_t last_timestamp = 0;
+	double   last_transit = 0.0;
+	double   jitter = 0.0; // RFC 3550 interarrival jitter, in samples
+	std::vector<uint8_t> payload;
+};
+
+int main(int argc, char** argv)
+{
+	const size_t calls = argc > 1 ? static_cast<size_t>(std::max(1, std::atoi(argv[1]))) : 200;
+	const double seconds = argc > 2 ? std::atof(argv[2]) : 5.0;
+	const G711::Law law = argc > 3 && std::string(argv[3]) == "alaw" ? G711::Law::Alaw : G711::Law::Ulaw;
+
+	benchmarkKernels(law);
+
+	// loopback receiver
+#ifdef _WIN32
+	WSADATA wsa;
+	WSAStartup(MAKEWORD(2, 2), &wsa);
+	using Socket = SOCKET;
+#else
+	using Socket = int;
+#endif
+	Socket receiver = socket(AF_INET, SOCK_DGRAM, 0);
+	int buffer_size = 8 << 20;
+	setsockopt(receiver, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&buffer_size), sizeof(buffer_size));
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t address_size = sizeof(address);
+	if (bind(receiver, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+		|| getsockname(receiver, reinterpret_cast<sockaddr*>(&address), &address_size) != 0) {
+		std::cerr << "cannot bind loopback receiver\n";
+		return 1;
+	}
+	const uint16_t port = ntohs(address.sin_port);
+#ifdef _WIN32
+	DWORD timeout_ms = 500;
+	setsockopt(receiver, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout_ms), sizeof(timeout_ms));
+#else
+	timeval timeout{ 0, 500000 };
+	setsockopt(receiver, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+#endif
+
+	std::map<uint32_t, ReceivedStream> streams;
+	std::atomic<bool> receiving{ true };
+	const auto epoch = std::chrono::steady_clock::now();
+	std::thread receive_thread([&]() {
+		uint8_t packet[2048];
+		while (receiving.load()) {
+			int size = static_cast<int>(recv(receiver, reinterpret_cast<char*>(packet), sizeof(packet), 0));
+			if (size <= 0) continue;
+			double arrival = secondsSince(epoch) * kTelephonyRate; // in RTP clock units
+			uint32_t ssrc = (uint32_t(packet[8]) << 24) | (uint32_t(packet[9]) << 16) | (uint32_t(packet[10]) << 8) | packet[11];
+			uint16_t sequence = static_cast<uint16_t>((packet[2] << 8) | packet[3]);
+			uint32_t timestamp = (uint32_t(packet[4]) << 24) | (uint32_t(packet[5]) << 16) | (uint32_t(packet[6]) << 8) | packet[7];
+			ReceivedStream& stream = streams[ssrc];
+			if (size != static_cast<int>(TelephonySink::kHeaderSize + TelephonySink::kFrameSamples)
+				|| packet[0] != 0x80 || (packet[1] & 0x7F) != G711::payloadType(law)) {
+				stream.malformed++;
+				continue;
+			}
+			if (packet[1] & 0x80) stream.markers++;
+			double transit = arrival - timestamp;
+			if (stream.packets > 0) {
+				uint16_t sequence_step = static_cast<uint16_t>(sequence - stream.last_sequence);
+				uint32_t timestamp_step = timestamp - stream.last_timestamp;
+				if (sequence_step == 0 || sequence_step > 0x8000) stream.malformed++; // duplicate or reordered
+				else stream.lost += sequence_step - 1;
+				if (timestamp_step % TelephonySink::kFrameSamples != 0 || timestamp_step < sequence_step * TelephonySink::kFrameSamples) stream.malformed++;
+				stream.jitter += (std::abs(transit - stream.last_transit) - stream.jitter) / 16.0;
+			}
+			stream.payload.insert(stream.payload.end(), packet + TelephonySink::kHeaderSize, packet + size);
+			stream.last_transit = transit;
+			stream.last_sequence = sequence;
+			stream.last_timestamp = timestamp;
+			stream.packets++;
+		}
+	});
+
+	// calls, fed with 100 ms of pcm_24000 at a time like a network stream
+	TelephonySink sink;
+	std::vector<std::shared_ptr<TelephonyCall>> active;
+	for (size_t i = 0; i < calls; i++) {
+		active.push_back(std::make_shared<TelephonyCall>("127.0.0.1", port, law, "pcm_24000"));
+		active.back()->beginUtterance(120); // more than one feed interval, so arrival phase never starves a call
+		sink.add(active.back());
+	}
+	const std::vector<int16_t> chunk = testSignal(2400);
+	const std::clock_t cpu_start = std::clock();
+	const auto start = std::chrono::steady_clock::now();
+	size_t fed = 0;
+	for (auto next = start; secondsSince(start) < seconds; next += std::chrono::milliseconds(100)) {
+		std::this_thread::sleep_until(next);
+		for (auto& call : active) {
+			call->write(reinterpret_cast<const char*>(chunk.data()), chunk.size() * sizeof(int16_t));
+		}
+		fed++;
+	}
+	for (auto& call : active) call->endUtterance();
+	std::this_thread::sleep_for(std::chrono::milliseconds(500)); // let the pacer drain
+	const double wall_s = secondsSince(start);
+	const double cpu_s = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+	for (auto& call : active) sink.remove(call);
+	receiving.store(false);
+	receive_thread.join();
+
+	size_t sent = 0, underruns = 0, received = 0, malformed = 0, lost = 0, markers = 0;
+	double max_jitter = 0.0;
+	for (auto& call : active) {
+		sent += call->packetsSent();
+		underruns += call->underruns();
+	}
+	for (const auto& entry : streams) {
+		received += entry.second.packets;
+		malformed += entry.second.malformed;
+		lost += entry.second.lost;
+		markers += entry.second.markers;
+		max_jitter = std::max(max_jitter, entry.second.jitter);
+	}
+	const size_t expected = fed * calls * 5; // five packets per 100 ms chunk
+
+	// payload: skip the filter's warm-up, then take whole 10 ms blocks so both tones fall on a DFT bin
+	double worst_passband_db = 0.0, worst_rejection_db = 1000.0;
+	size_t analysed = 0;
+	std::vector<int16_t> decoded;
+	for (const auto& entry : streams) {
+		const std::vector<uint8_t>& payload = entry.second.payload;
+		const size_t skip = kTelephonyRate / 10;
+		if (payload.size() < skip + kTelephonyRate / 10) continue;
+		const size_t count = (payload.size() - skip) / 80 * 80;
+		decoded.resize(count);
+		G711::decode(law, payload.data() + skip, count, decoded.data());
+		double passband_db = 20.0 * std::log10(toneLevel(decoded, kInBandHz) / kInBandLevel);
+		// floored at one LSB: G.711 of a pure 1 kHz tone has no 2 kHz harmonic, so a clean stream measures 0 there
+		double rejection_db = 20.0 * std::log10(kOutOfBandLevel / std::max(toneLevel(decoded, kTelephonyRate - kOutOfBandHz), 1.0));
+		if (std::abs(passband_db) > std::abs(worst_passband_db)) worst_passband_db = passband_db;
+		worst_rejection_db = std::min(worst_rejection_db, rejection_db);
+		analysed++;
+	}
+	const bool payload_ok = analysed == calls && std::abs(worst_passband_db) <= 1.0 && worst_rejection_db >= 40.0;
+
+	std::printf("loopback: %zu calls for %.1f s, %zu packets sent (%zu expected), %zu received\n", calls, wall_s, sent, expected, received);
+	std::printf("  streams %zu, lost %zu, malformed %zu, talkspurt markers %zu, pacer underruns %zu, skipped ticks %zu\n",
+		streams.size(), lost, malformed, markers, underruns, sink.skippedTicks());
+	std::printf("  worst interarrival jitter %.2f ms, process CPU %.1f%% of one core (%.1f us per call per second)\n",
+		max_jitter * 1000.0 / kTelephonyRate, 100.0 * cpu_s / wall_s, cpu_s / wall_s / calls * 1e6);
+	std::printf("  payload of %zu streams: 1 kHz tone %+.2f dB (worst), 6 kHz tone rejected by %.1f dB (worst)\n",
+		analysed, worst_passband_db, worst_rejection_db);
+
+	const bool ok = streams.size() == calls && malformed == 0 && lost == 0 && underruns == 0 && sent == received && sent == expected && payload_ok;
+	std::printf("%s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,458 @@
+#ifndef TELEPHONY_SINK_HPP
+#define TELEPHONY_SINK_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "AudioEngine.hpp"
+
+// Telephony output: stream audio converted to 8 kHz G.711 and sent to a call as 20 ms RTP packets over UDP.
+
+static const int kTelephonyRate = 8000;
+
+// G.711 companding, bit-exact with the ITU-T G.191 reference. The encoder only looks at the top
+// 14 (mu-law) or 12 (A-law) bits of the sample, so each direction is a single table load per sample.
+class G711 {
+public:
+    enum class Law { Ulaw, Alaw };
+
+    static uint8_t payloadType(Law law) { return law == Law::Ulaw ? 0 : 8; } // PCMU / PCMA
+
+    static void encode(Law law, const int16_t* in, size_t count, uint8_t* out) {
+        if (law == Law::Ulaw) {
+            const auto& table = ulawEncodeTable();
+            for (size_t i = 0; i < count; i++) out[i] = table[static_cast<uint16_t>(in[i]) >> 2];
+        }
+        else {
+            const auto& table = alawEncodeTable();
+            for (size_t i = 0; i < count; i++) out[i] = table[static_cast<uint16_t>(in[i]) >> 4];
+        }
+    }
+
+    static void decode(Law law, const uint8_t* in, size_t count, int16_t* out) {
+        const auto& table = law == Law::Ulaw ? ulawDecodeTable() : alawDecodeTable();
+        for (size_t i = 0; i < count; i++) out[i] = table[in[i]];
+    }
+
+    static uint8_t ulawCompress(int16_t x) {
+        int magnitude = (x < 0 ? (~x) >> 2 : x >> 2) + 33; // one's complement for negative values
+        magnitude = (std::min)(magnitude, 0x1FFF);
+        int segment = 1;
+        for (int i = magnitude >> 6; i != 0; i >>= 1) segment++;
+        int code = ((8 - segment) << 4) | (0x0F - ((magnitude >> segment) & 0x0F));
+        return static_cast<uint8_t>(x >= 0 ? code | 0x80 : code);
+    }
+
+    static int16_t ulawExpand(uint8_t code) {
+        int mantissa = ~code;
+        int exponent = (mantissa >> 4) & 0x07;
+        int step = 4 << (exponent + 1);
+        mantissa &= 0x0F;
+        int value = (0x80 << exponent) + step * mantissa + step / 2 - 4 * 33;
+        return static_cast<int16_t>(code < 0x80 ? -value : value);
+    }
+
+    static uint8_t alawCompress(int16_t x) {
+        int ix = x < 0 ? (~x) >> 4 : x >> 4;
+        if (ix > 15) {
+            int exponent = 1;
+            while (ix > 16 + 15) {
+                ix >>= 1;
+                exponent++;
+            }
+            ix -= 16;
+            ix += exponent << 4;
+        }
+        if (x >= 0) ix |= 0x80;
+        return static_cast<uint8_t>(ix ^ 0x55);
+    }
+
+    static int16_t alawExpand(uint8_t code) {
+        int ix = (code ^ 0x55) & 0x7F;
+        int exponent = ix >> 4;
+        int mantissa = ix & 0x0F;
+        if (exponent > 0) mantissa += 16;
+        mantissa = (mantissa << 4) + 0x08;
+        if (exponent > 1) mantissa <<= exponent - 1;
+        return static_cast<int16_t>(code > 127 ? mantissa : -mantissa);
+    }
+
+private:
+    static const std::array<uint8_t, 16384>& ulawEncodeTable() {
+        static const auto table = []() {
+            std::array<uint8_t, 16384> t{};
+            for (size_t i = 0; i < t.size(); i++) t[i] = ulawCompress(static_cast<int16_t>(static_cast<uint16_t>(i << 2)));
+            return t;
+        }();
+        return table;
+    }
+
+    static const std::array<uint8_t, 4096>& alawEncodeTable() {
+        static const auto table = []() {
+            std::array<uint8_t, 4096> t{};
+            for (size_t i = 0; i < t.size(); i++) t[i] = alawCompress(static_cast<int16_t>(static_cast<uint16_t>(i << 4)));
+            return t;
+        }();
+        return table;
+    }
+
+    static const std::array<int16_t, 256>& ulawDecodeTable() {
+        static const auto table = []() {
+            std::array<int16_t, 256> t{};
+            for (size_t i = 0; i < t.size(); i++) t[i] = ulawExpand(static_cast<uint8_t>(i));
+            return t;
+        }();
+        return table;
+    }
+
+    static const std::array<int16_t, 256>& alawDecodeTable() {
+        static const auto table = []() {
+            std::array<int16_t, 256> t{};
+            for (size_t i = 0; i < t.size(); i++) t[i] = alawExpand(static_cast<uint8_t>(i));
+            return t;
+        }();
+        return table;
+    }
+};
+
+// Low-pass FIR and decimation from a multiple of 8 kHz (pcm_16000, pcm_24000...) down to 8 kHz.
+// Q15 coefficients with 32-bit accumulation: the inner loop is a plain int16 multiply-add over
+// contiguous memory, which compilers turn into SIMD multiply-add (pmaddwd / vpmaddwd / smlal).
+class TelephonyResampler {
+public:
+    explicit TelephonyResampler(int input_rate = kTelephonyRate) : factor_{ static_cast<size_t>(input_rate / kTelephonyRate) } {
+        if (input_rate <= 0 || input_rate % kTelephonyRate != 0) {
+            throw std::runtime_error("telephony output needs a sample rate that is a multiple of 8000, got " + std::to_string(input_rate));
+        }
+        if (factor_ == 1) {
+            return;
+        }
+        // Hamming-windowed sinc, cut off at 3.4 kHz where the telephone band ends
+        const size_t taps = kTapBlock * factor_;
+        const double cutoff = 3400.0 / input_rate;
+        const double pi = 3.14159265358979323846;
+        std::vector<double> h(taps);
+        double sum = 0.0;
+        for (size_t i = 0; i < taps; i++) {
+            double t = static_cast<double>(i) - (taps - 1) / 2.0;
+            double sinc = t == 0.0 ? 2.0 * cutoff : std::sin(2.0 * pi * cutoff * t) / (pi * t);
+            h[i] = sinc * (0.54 - 0.46 * std::cos(2.0 * pi * i / (taps - 1)));
+            sum += h[i];
+        }
+        coefficients_.resize(taps);
+        for (size_t i = 0; i < taps; i++) {
+            coefficients_[i] = static_cast<int16_t>(std::lround(h[i] / sum * 32768.0)); // unity gain at DC
+        }
+        window_.assign(taps - 1, 0);
+    }
+
+    bool passthrough() const { return factor_ == 1; }
+
+    // Appends the 8 kHz samples to out
+    void process(const int16_t* in, size_t count, std::vector<int16_t>& out) {
+        if (factor_ == 1) {
+            out.insert(out.end(), in, in + count);
+            return;
+        }
+        // window_ holds the last taps - 1 input samples followed by the new ones
+        const size_t taps = coefficients_.size();
+        const size_t history = taps - 1;
+        window_.resize(history + count);
+        std::memcpy(window_.data() + history, in, count * sizeof(int16_t));
+
+        size_t pos = next_;
+        const int16_t* h = coefficients_.data();
+        while (pos + taps <= window_.size()) {
+            const int16_t* x = window_.data() + pos;
+            int32_t acc = 0;
+            for (size_t block = 0; block < taps; block += kTapBlock) {
+                // fixed trip count, so even -O2 vectorises it
+                for (size_t k = 0; k < kTapBlock; k++) {
+                    acc += static_cast<int32_t>(x[block + k]) * h[block + k];
+                }
+            }
+            acc = (acc + (1 << 14)) >> 15;
+            out.push_back(static_cast<int16_t>(std::clamp(acc, -32768, 32767)));
+            pos += factor_;
+        }
+        next_ = pos - (window_.size() - history);
+        std::memmove(window_.data(), window_.data() + window_.size() - history, history * sizeof(int16_t));
+        window_.resize(history);
+    }
+
+    void reset() {
+        std::fill(window_.begin(), window_.end(), static_cast<int16_t>(0));
+        next_ = 0;
+    }
+
+private:
+    static const size_t kTapBlock = 32;
+
+    size_t               factor_;
+    std::vector<int16_t> coefficients_;
+    std::vector<int16_t> window_;
+    size_t               next_ = 0; // where the next output's window starts, relative to window_
+};
+
+// One call leg. The stream thread writes audio in the API's output format; it is converted to
+// 8 kHz PCM and queued with the same flow control as local playback, until TelephonySink sends it.
+class TelephonyCall {
+public:
+    // input_format is the output_format requested from the API: "ulaw_8000" needs no conversion,
+    // PCM formats must be a multiple of 8 kHz (pcm_16000, pcm_24000)
+    TelephonyCall(const std::string& host, uint16_t port, G711::Law law = G711::Law::Ulaw, const std::string& input_format = "ulaw_8000")
+        : law_{ law }, input_format_{ input_format } {
+        ulaw_input_ = input_format == "ulaw_8000";
+        if (!ulaw_input_) {
+            if (input_format.compare(0, 4, "pcm_") != 0) {
+                throw std::runtime_error("unsupported telephony input format: " + input_format);
+            }
+            resampler_ = TelephonyResampler(std::stoi(input_format.substr(4)));
+        }
+
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        addrinfo* result = nullptr;
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0 || result == nullptr) {
+            throw std::runtime_error("cannot resolve RTP endpoint: " + host);
+        }
+        std::memcpy(&address_, result->ai_addr, sizeof(address_));
+        freeaddrinfo(result);
+
+        std::random_device random;
+        ssrc_ = random();
+        sequence_ = static_cast<uint16_t>(random());
+        timestamp_ = random();
+    }
+
+    TelephonyCall(const TelephonyCall&) = delete;
+    TelephonyCall& operator=(const TelephonyCall&) = delete;
+
+    const std::string& inputFormat() const { return input_format_; }
+    G711::Law law() const { return law_; }
+    uint32_t ssrc() const { return ssrc_; }
+
+    // Start of a new utterance on the stream thread: forget filter state from the previous one. Sending
+    // (re)starts once prebuffer_ms of audio is queued, which absorbs network jitter like a playout buffer.
+    void beginUtterance(int prebuffer_ms = 60) {
+        resampler_.reset();
+        carry_.clear();
+        prebuffer_samples_.store(static_cast<size_t>((std::max)(prebuffer_ms, 0)) * kTelephonyRate / 1000, std::memory_order_relaxed);
+        flush_.store(false, std::memory_order_release);
+    }
+
+    // End of the utterance: the last partial frame is sent padded with silence instead of waiting for more
+    void endUtterance() { flush_.store(true, std::memory_order_release); }
+
+    // Converts and queues a chunk of stream output, all or nothing (see PlaybackBuffer::write)
+    bool write(const char* data, size_t size) {
+        samples_.clear();
+        if (ulaw_input_) {
+            samples_.resize(size);
+            G711::decode(G711::Law::Ulaw, reinterpret_cast<const uint8_t*>(data), size, samples_.data());
+        }
+        else {
+            // a chunk can end half way through a sample; that byte is kept for the next one
+            const char* bytes = data;
+            size_t length = size;
+            if (!carry_.empty()) {
+                joined_.assign(carry_).append(data, size);
+                bytes = joined_.data();
+                length = joined_.size();
+            }
+            pcm_.resize(length / sizeof(int16_t));
+            if (!pcm_.empty()) {
+                std::memcpy(pcm_.data(), bytes, pcm_.size() * sizeof(int16_t));
+            }
+            next_resampler_ = resampler_; // only advanced if the write goes through
+            next_resampler_.process(pcm_.data(), pcm_.size(), samples_);
+            if (!buffer_.write(samples_.data(), samples_.size())) {
+                return false;
+            }
+            std::swap(resampler_, next_resampler_);
+            carry_.assign(bytes + pcm_.size() * sizeof(int16_t), length % sizeof(int16_t));
+            return true;
+        }
+        return buffer_.write(samples_.data(), samples_.size());
+    }
+
+    PlaybackBuffer& buffer() { return buffer_; }
+
+    size_t packetsSent() const { return packets_.load(std::memory_order_relaxed); }
+    size_t underruns() const { return underruns_.load(std::memory_order_relaxed); }
+
+private:
+    friend class TelephonySink;
+
+    G711::Law            law_;
+    std::string          input_format_;
+    bool                 ulaw_input_ = true;
+    sockaddr_in          address_{};
+
+    // stream thread
+    TelephonyResampler   resampler_;
+    TelephonyResampler   next_resampler_;
+    std::string          carry_;
+    std::string          joined_;
+    std::vector<int16_t> pcm_;
+    std::vector<int16_t> samples_;
+    PlaybackBuffer       buffer_;
+    std::atomic<size_t>  prebuffer_samples_{ 0 };
+    std::atomic<bool>    flush_{ false };
+
+    // pacer thread
+    uint32_t             ssrc_ = 0;
+    uint16_t             sequence_ = 0;
+    uint32_t             timestamp_ = 0;
+    bool                 talking_ = false;
+    std::atomic<size_t>  packets_{ 0 };
+    std::atomic<size_t>  underruns_{ 0 };
+};
+
+// Paces every call from one thread: on each 20 ms tick, each call with a full frame queued gets one
+// RTP packet. The RTP clock of a call advances on every tick, sent or not, so gaps stay gaps at the
+// receiver, and the first packet after silence carries the marker bit. With a single socket and no
+// per-call thread, one core paces hundreds of calls.
+class TelephonySink {
+public:
+    static const size_t kFrameSamples = kTelephonyRate / 50; // 20 ms
+    static const size_t kHeaderSize = 12;
+
+    TelephonySink() {
+#ifdef _WIN32
+        WSADATA wsa;
+        WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+        socket_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+        if (socket_ == kInvalidSocket) {
+            throw std::runtime_error("cannot open UDP socket for RTP");
+        }
+        pacer_ = std::thread(&TelephonySink::run, this);
+    }
+
+    ~TelephonySink() {
+        running_.store(false, std::memory_order_release);
+        pacer_.join();
+#ifdef _WIN32
+        closesocket(socket_);
+        WSACleanup();
+#else
+        close(socket_);
+#endif
+    }
+
+    TelephonySink(const TelephonySink&) = delete;
+    TelephonySink& operator=(const TelephonySink&) = delete;
+
+    void add(std::shared_ptr<TelephonyCall> call) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        calls_.emplace_back(std::move(call));
+    }
+
+    void remove(const std::shared_ptr<TelephonyCall>& call) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        calls_.erase(std::remove(calls_.begin(), calls_.end(), call), calls_.end());
+    }
+
+    // Ticks the pacer gave up on after falling more than 100 ms behind
+    size_t skippedTicks() const { return skipped_.load(std::memory_order_relaxed); }
+
+private:
+#ifdef _WIN32
+    using Socket = SOCKET;
+    static constexpr Socket kInvalidSocket = INVALID_SOCKET;
+#else
+    using Socket = int;
+    static constexpr Socket kInvalidSocket = -1;
+#endif
+    using Clock = std::chrono::steady_clock;
+
+    Socket                                      socket_;
+    std::thread                                 pacer_;
+    std::atomic<bool>                           running_{ true };
+    std::mutex                                  mutex_;
+    std::vector<std::shared_ptr<TelephonyCall>> calls_;
+    std::atomic<size_t>                         skipped_{ 0 };
+
+    void run() {
+        const auto tick = std::chrono::milliseconds(1000 * kFrameSamples / kTelephonyRate);
+        std::array<int16_t, kFrameSamples> frame;
+        std::array<uint8_t, kHeaderSize + kFrameSamples> packet;
+        auto next = Clock::now();
+        while (running_.load(std::memory_order_acquire)) {
+            next += tick;
+            std::this_thread::sleep_until(next);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (auto& call : calls_) {
+                    service(*call, frame.data(), packet.data());
+                }
+            }
+            // after a long stall (suspended process...) resynchronise rather than burst the backlog
+            auto behind = Clock::now() - next;
+            if (behind > 5 * tick) {
+                skipped_.fetch_add(static_cast<size_t>(behind / tick), std::memory_order_relaxed);
+                next = Clock::now();
+            }
+        }
+    }
+
+    void service(TelephonyCall& call, int16_t* frame, uint8_t* packet) {
+        PlaybackBuffer& buffer = call.buffer_;
+        const bool flushing = call.flush_.load(std::memory_order_acquire);
+        const size_t needed = call.talking_ ? kFrameSamples : (std::max)(kFrameSamples, call.prebuffer_samples_.load(std::memory_order_relaxed));
+        size_t count = buffer.size() >= needed || flushing ? buffer.read(frame, kFrameSamples) : 0;
+
+        if (count == 0) {
+            if (call.talking_ && !flushing) {
+                call.underruns_.fetch_add(1, std::memory_order_relaxed);
+            }
+            call.talking_ = false;
+        }
+        else {
+            std::fill(frame + count, frame + kFrameSamples, static_cast<int16_t>(0)); // pad the tail of an utterance
+            packet[0] = 0x80; // version 2, no padding, extension or CSRCs
+            packet[1] = static_cast<uint8_t>((call.talking_ ? 0x00 : 0x80) | G711::payloadType(call.law_));
+            writeBigEndian(packet + 2, call.sequence_++, 2);
+            writeBigEndian(packet + 4, call.timestamp_, 4);
+            writeBigEndian(packet + 8, call.ssrc_, 4);
+            G711::encode(call.law_, frame, kFrameSamples, packet + kHeaderSize);
+            sendto(socket_, reinterpret_cast<const char*>(packet), static_cast<int>(kHeaderSize + kFrameSamples), 0,
+                reinterpret_cast<const sockaddr*>(&call.address_), sizeof(call.address_));
+            call.packets_.fetch_add(1, std::memory_order_relaxed);
+            call.talking_ = true;
+        }
+        call.timestamp_ += static_cast<uint32_t>(kFrameSamples);
+    }
+
+    static void writeBigEndian(uint8_t* out, uint32_t value, size_t bytes) {
+        for (size_t i = 0; i < bytes; i++) {
+            out[i] = static_cast<uint8_t>(value >> (8 * (bytes - 1 - i)));
+        }
+    }
+};
+
+#endif // !TELEPHONY_SINK_HPP
@@ -0,0 +1,206 @@
+#ifndef TRACE_RECORDER_HPP
+#define TRACE_RECORDER_HPP
+
+// Low-overhead event tracing across the curl, decode and audio callback threads.
+// Build with ELEVENLABS_TRACE=1 to enable; otherwise every macro below compiles to nothing.
+// Output is Chrome trace JSON, viewable in chrome://tracing or https://ui.perfetto.dev
+//
+// Event and argument names must be string literals: only the pointer is recorded.
+#ifndef ELEVENLABS_TRACE
+#define ELEVENLABS_TRACE 0
+#endif
+
+#if ELEVENLABS_TRACE
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace elevenlabs {
+
+    class TraceRecorder {
+    public:
+        struct Event {
+            const char* name;
+            const char* arg_name;  // nullptr if the event has no argument
+            int64_t     arg_value;
+            uint64_t    timestamp_ns;
+            char        phase;     // 'B' begin, 'E' end, 'i' instant, 'C' counter
+        };
+
+        static const size_t kEventsPerThread = 1 << 16;
+
+        struct ThreadBuffer {
+            std::array<Event, kEventsPerThread> events;
+            std::atomic<size_t> count{ 0 };
+            std::atomic<size_t> dropped{ 0 };
+            int                 tid = 0;
+            std::string         name;
+        };
+
+        static TraceRecorder& instance() {
+            static TraceRecorder recorder;
+            return recorder;
+        }
+
+        // Wait-free: each thread only ever appends to its own buffer
+        void record(char phase, const char* name, const char* arg_name = nullptr, int64_t arg_value = 0) {
+            ThreadBuffer& buffer = threadBuffer();
+            size_t index = buffer.count.load(std::memory_order_relaxed);
+            if (index >= kEventsPerThread) {
+                buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            buffer.events[index] = { name, arg_name, arg_value, now(), phase };
+            buffer.count.store(index + 1, std::memory_order_release);
+        }
+
+        // For a thread that must never lock or allocate, such as the audio callback: create its buffer
+        // ahead of time from another thread, then attach it from the real-time thread itself
+        ThreadBuffer* preallocateThreadBuffer(const char* name) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ThreadBuffer* buffer = addBuffer();
+            buffer->name = name;
+            return buffer;
+        }
+
+        // Wait-free; later events from the calling thread go to buffer
+        static void attachThreadBuffer(ThreadBuffer* buffer) { currentBuffer() = buffer; }
+
+        // Cheap to call repeatedly: only the first call per thread takes the lock
+        void setThreadName(const char* name) {
+            ThreadBuffer& buffer = threadBuffer();
+            if (buffer.name == name) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            buffer.name = name;
+        }
+
+        // Writes every event recorded so far; safe to call while other threads keep tracing
+        bool writeChromeTrace(const std::string& path) {
+            std::ofstream out(path);
+            if (!out) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+            bool first = true;
+            auto separator = [&]() { out << (first ? "" : ",\n"); first = false; };
+            for (const auto& buffer : buffers_) {
+                if (!buffer->name.empty()) {
+                    separator();
+                    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+                        << ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+                }
+                size_t count = buffer->count.load(std::memory_order_acquire);
+                for (size_t i = 0; i < count; i++) {
+                    const Event& event = buffer->events[i];
+                    separator();
+                    out << "{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase << "\",\"pid\":1,\"tid\":" << buffer->tid
+                        << ",\"ts\":" << (event.timestamp_ns - start_ns_) / 1000 << '.' << (event.timestamp_ns - start_ns_) % 1000 / 100;
+                    if (event.phase == 'i') {
+                        out << ",\"s\":\"t\"";
+                    }
+                    if (event.arg_name != nullptr) {
+                        out << ",\"args\":{\"" << event.arg_name << "\":" << event.arg_value << '}';
+                    }
+                    out << '}';
+                }
+                size_t dropped = buffer->dropped.load(std::memory_order_relaxed);
+                if (dropped > 0) {
+                    separator();
+                    out << "{\"name\":\"events dropped\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << buffer->tid
+                        << ",\"ts\":0,\"args\":{\"count\":" << dropped << "}}";
+                }
+            }
+            out << "\n]}\n";
+            return static_cast<bool>(out);
+        }
+
+    private:
+        TraceRecorder() : start_ns_{ now() } {}
+
+        static uint64_t now() {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        static ThreadBuffer*& currentBuffer() {
+            thread_local ThreadBuffer* buffer = nullptr;
+            return buffer;
+        }
+
+        // Buffers live until the recorder is destroyed so a trace can be written after threads exit
+        ThreadBuffer& threadBuffer() {
+            ThreadBuffer*& buffer = currentBuffer();
+            if (buffer == nullptr) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                buffer = addBuffer();
+            }
+            return *buffer;
+        }
+
+        // Called with mutex_ held
+        ThreadBuffer* addBuffer() {
+            buffers_.emplace_back(new ThreadBuffer());
+            ThreadBuffer* buffer = buffers_.back().get();
+            buffer->tid = static_cast<int>(buffers_.size());
+            return buffer;
+        }
+
+        uint64_t                                   start_ns_;
+        std::mutex                                 mutex_;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+    };
+
+    // Emits a begin event now and the matching end event when it goes out of scope
+    class TraceScope {
+    public:
+        explicit TraceScope(const char* name) : name_{ name } { TraceRecorder::instance().record('B', name_); }
+        ~TraceScope() { TraceRecorder::instance().record('E', name_); }
+    private:
+        const char* name_;
+    };
+
+} // namespace elevenlabs
+
+#define ELEVENLABS_TRACE_CONCAT_(a, b) a##b
+#define ELEVENLABS_TRACE_CONCAT(a, b) ELEVENLABS_TRACE_CONCAT_(a, b)
+
+#define ELEVENLABS_TRACE_SCOPE(name) elevenlabs::TraceScope ELEVENLABS_TRACE_CONCAT(trace_scope_, __LINE__){ name }
+#define ELEVENLABS_TRACE_BEGIN(name) elevenlabs::TraceRecorder::instance().record('B', name)
+#define ELEVENLABS_TRACE_END(name) elevenlabs::TraceRecorder::instance().record('E', name)
+#define ELEVENLABS_TRACE_INSTANT(name) elevenlabs::TraceRecorder::instance().record('i', name)
+#define ELEVENLABS_TRACE_INSTANT_ARG(name, arg_name, value) elevenlabs::TraceRecorder::instance().record('i', name, arg_name, static_cast<int64_t>(value))
+#define ELEVENLABS_TRACE_COUNTER(name, value) elevenlabs::TraceRecorder::instance().record('C', name, name, static_cast<int64_t>(value))
+#define ELEVENLABS_TRACE_THREAD_NAME(name) elevenlabs::TraceRecorder::instance().setThreadName(name)
+#define ELEVENLABS_TRACE_THREAD_BUFFER(member) elevenlabs::TraceRecorder::ThreadBuffer* member = nullptr
+#define ELEVENLABS_TRACE_PREALLOCATE_THREAD(member, name) \
+    ((member) = (member) != nullptr ? (member) : elevenlabs::TraceRecorder::instance().preallocateThreadBuffer(name))
+#define ELEVENLABS_TRACE_ATTACH_THREAD(buffer) elevenlabs::TraceRecorder::attachThreadBuffer(buffer)
+#define ELEVENLABS_TRACE_WRITE(path) elevenlabs::TraceRecorder::instance().writeChromeTrace(path)
+
+#else
+
+#define ELEVENLABS_TRACE_SCOPE(name) ((void)0)
+#define ELEVENLABS_TRACE_BEGIN(name) ((void)0)
+#define ELEVENLABS_TRACE_END(name) ((void)0)
+#define ELEVENLABS_TRACE_INSTANT(name) ((void)0)
+#define ELEVENLABS_TRACE_INSTANT_ARG(name, arg_name, value) ((void)0)
+#define ELEVENLABS_TRACE_COUNTER(name, value) ((void)0)
+#define ELEVENLABS_TRACE_THREAD_NAME(name) ((void)0)
+#define ELEVENLABS_TRACE_THREAD_BUFFER(member) static_assert(true, "")
+#define ELEVENLABS_TRACE_PREALLOCATE_THREAD(member, name) ((void)0)
+#define ELEVENLABS_TRACE_ATTACH_THREAD(buffer) ((void)0)
+#define ELEVENLABS_TRACE_WRITE(path) ((void)0)
+
+#endif // ELEVENLABS_TRACE
+
+#endif // !TRACE_RECORDER_HPP